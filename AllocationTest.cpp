@@ -0,0 +1,211 @@
+/**
+ * Allocation regression tests for BinaryTree.
+ * Replaces the global operator new so that every heap allocation made by the
+ * code under test is counted. The Counters policy hooks are checked for balance too.
+ */
+
+#include "doctest.h"
+#include "BinaryTree.hpp"
+#include "TreeGenerator.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace ariel;
+
+static std::atomic<std::size_t> allocations{0};
+
+void *operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+void operator delete(void *p, std::size_t /*size*/) noexcept
+{
+    std::free(p);
+}
+void operator delete[](void *p, std::size_t /*size*/) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+    const std::size_t SIZE = 1000;
+
+    template <typename Tree>
+    std::size_t allocationsDuring(Tree &tree, typename Tree::iterator (Tree::*begin)(), typename Tree::iterator (Tree::*end)(), long &sum)
+    {
+        std::size_t before = allocations.load();
+        for (auto it = (tree.*begin)(); it != (tree.*end)(); ++it)
+        {
+            sum += *it;
+        }
+        return allocations.load() - before;
+    }
+}
+
+TEST_CASE("Building n nodes allocates exactly n times")
+{
+    BinaryTree<int> tree;
+    std::size_t before = allocations.load();
+    tree.add_root(0);
+    for (int i = 1; i < int(SIZE); ++i)
+    {
+        if (i % 2 == 1)
+        {
+            tree.add_left(i - 1, i);
+        }
+        else
+        {
+            tree.add_right(i - 2, i);
+        }
+    }
+    CHECK(allocations.load() - before == SIZE);
+
+    before = allocations.load();
+    tree.add_left(0, 42); // replaces an existing child in place
+    tree.add_root(7);     // replaces the root value in place
+    CHECK(allocations.load() - before == 0);
+}
+
+TEST_CASE("Traversals do not allocate")
+{
+    for (Shape shape : {Shape::COMPLETE, Shape::RANDOM_SPLIT, Shape::LEFT_CHAIN, Shape::RIGHT_CHAIN, Shape::CATERPILLAR})
+    {
+        BinaryTree<int> tree = TreeGenerator<int>(SIZE).build(shape, SIZE);
+        using Tree = BinaryTree<int>;
+        long sum = 0;
+        CHECK(allocationsDuring(tree, &Tree::begin_preorder, &Tree::end_preorder, sum) == 0);
+        CHECK(allocationsDuring(tree, &Tree::begin_inorder, &Tree::end_inorder, sum) == 0);
+        CHECK(allocationsDuring(tree, &Tree::begin_postorder, &Tree::end_postorder, sum) == 0);
+        CHECK(sum == 3 * long(SIZE) * long(SIZE - 1) / 2);
+    }
+}
+
+TEST_CASE("Stack iterators do not allocate within their inline depth")
+{
+    BinaryTree<int> tree = TreeGenerator<int>(2).complete(SIZE);
+    long sum = 0;
+    std::size_t before = allocations.load();
+    for (int v : tree.walk<Walk::PREORDER>())
+    {
+        sum += v;
+    }
+    for (int v : tree.walk<Walk::INORDER>())
+    {
+        sum += v;
+    }
+    for (int v : tree.walk<Walk::POSTORDER>())
+    {
+        sum += v;
+    }
+    std::size_t during = allocations.load() - before;
+    CHECK(during == 0);
+    CHECK(sum == 3 * long(SIZE) * long(SIZE - 1) / 2);
+}
+
+TEST_CASE("Range-for, postfix increment and dereference do not allocate")
+{
+    BinaryTree<std::string> tree = TreeGenerator<std::string>(1).values(Values::SHUFFLED).complete(SIZE);
+    std::size_t before = allocations.load();
+    std::size_t length = 0;
+    for (const std::string &element : tree)
+    {
+        length += element.size();
+    }
+    for (auto it = tree.begin_postorder(); it != tree.end_postorder();)
+    {
+        auto copy = it++;
+        length += copy->size();
+        length += (*copy).size();
+    }
+    std::size_t during = allocations.load() - before;
+    CHECK(during == 0);
+    CHECK(length > 0);
+}
+
+TEST_CASE("Every counted allocation is matched by a counted free")
+{
+    struct ArenaTag;
+    using Counted = AtomicCounters<ArenaTag>;
+    using Tree = BinaryTree<int, Counted>;
+    Counted::reset();
+    {
+        Tree fromTraversals = Tree::from_preorder_inorder(std::vector<int>{1, 2, 3}, std::vector<int>{2, 1, 3});
+        Tree fromParents = Tree::from_parent_array(std::vector<int>{1, 2, 3}, std::vector<int>{-1, 0, 0}, std::vector<bool>{false, true, false});
+        Tree fromLevels = Tree::from_level_order(std::vector<int>{1, 2, 3}, 0);
+        fromTraversals.add_left(2, 4).add_right(2, 5); // heap nodes below arena nodes
+        CHECK(Counted::snapshot().allocations == 5);
+        CHECK(Counted::snapshot().frees == 0);
+    }
+    CHECK(Counted::snapshot().frees == Counted::snapshot().allocations);
+
+    SUBCASE("an arena shared by extract_subtree and graft is freed once, with its last tree")
+    {
+        Counted::reset();
+        {
+            Tree moved;
+            {
+                Tree source = Tree::from_level_order(std::vector<int>{1, 2, 3, 4}, 0);
+                Tree sub = source.extract_subtree(source.find(2));
+                moved.add_root(9);
+                moved.graft_left(moved.root_handle(), std::move(sub));
+            }
+            CHECK(Counted::snapshot().allocations == 2);
+            CHECK(Counted::snapshot().frees == 0);
+        }
+        CHECK(Counted::snapshot().frees == 2);
+    }
+}
+
+TEST_CASE("Looking up a string tree by string_view or const char * builds no std::string")
+{
+    // longer than any small-string buffer, so a temporary std::string would allocate
+    const char *const KEYS[] = {"a key long enough to live on the heap, number one",
+                                "a key long enough to live on the heap, number two",
+                                "a key long enough to live on the heap, number three"};
+    BinaryTree<std::string> tree;
+    tree.add_root(KEYS[0]).add_left(KEYS[0], KEYS[1]).add_right(KEYS[0], KEYS[2]);
+    std::string_view view = KEYS[2];
+
+    std::size_t before = allocations.load();
+    bool found = tree.contains(view) && tree.contains(KEYS[1]) && !tree.contains("missing");
+    found = found && tree.find(view) != tree.end() && tree.find(KEYS[1]) != tree.end();
+    CHECK(allocations.load() - before == 0);
+    CHECK(found);
+
+    // adding below a parent found by key allocates exactly what adding below a std::string does
+    std::string parent = KEYS[1];
+    std::string child = KEYS[2];
+    before = allocations.load();
+    tree.add_left(parent, child);
+    std::size_t byString = allocations.load() - before;
+    before = allocations.load();
+    tree.add_right(std::string_view(parent), child);
+    CHECK(allocations.load() - before == byString);
+    before = allocations.load();
+    tree.add_left(KEYS[2], child);
+    CHECK(allocations.load() - before == byString);
+    CHECK_THROWS_AS(tree.add_left(std::string_view("missing"), child), std::invalid_argument);
+}
@@ -0,0 +1,177 @@
+/**
+ * Traversal benchmark for BinaryTree.
+ * Builds generated trees of several shapes and sizes and walks them in every order,
+ * reporting wall time and hardware counters per element traversed.
+ *
+ * Usage: ./bench [size...]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+using namespace std;
+#include "BinaryTree.hpp"
+#include "CompactTree.hpp"
+#include "PerfCounters.hpp"
+#include "TreeGenerator.hpp"
+using namespace ariel;
+
+static const int REPEATS = 5;
+
+struct Measurement
+{
+  double nanos = 0;
+  double counters[PerfCounters::EVENT_COUNT] = {};
+  size_t elements = 0;
+};
+
+// walk(sink) traverses the tree once, adding every value to sink, and returns the element count
+template <typename Walk>
+static Measurement measure(PerfCounters &counters, Walk walk)
+{
+  Measurement best;
+  long sink = 0;
+  for (int r = 0; r < REPEATS; ++r)
+  {
+    counters.start();
+    auto start = chrono::steady_clock::now();
+    size_t elements = walk(sink);
+    auto stop = chrono::steady_clock::now();
+    counters.stop();
+    double nanos = chrono::duration<double, nano>(stop - start).count();
+    if (r == 0 || nanos < best.nanos)
+    {
+      best.nanos = nanos;
+      best.elements = elements;
+      for (int e = 0; e < PerfCounters::EVENT_COUNT; ++e)
+      {
+        best.counters[e] = counters.value(PerfCounters::Event(e));
+      }
+    }
+  }
+  if (sink == 1)
+  {
+    puts("");
+  }
+  return best;
+}
+
+template <typename Begin, typename End>
+static Measurement measure(PerfCounters &counters, Begin begin, End end)
+{
+  return measure(counters, [&](long &sink) {
+    size_t elements = 0;
+    for (auto it = begin(); it != end(); ++it)
+    {
+      sink += *it;
+      ++elements;
+    }
+    return elements;
+  });
+}
+
+template <typename ForEach>
+static Measurement measureVisitor(PerfCounters &counters, ForEach forEach)
+{
+  return measure(counters, [&](long &sink) {
+    size_t elements = 0;
+    forEach([&](int value) {
+      sink += value;
+      ++elements;
+    });
+    return elements;
+  });
+}
+
+static void report(const PerfCounters &counters, const char *shape, size_t n, const char *order, const Measurement &m)
+{
+  double per = m.elements == 0 ? 0 : 1.0 / double(m.elements);
+  printf("%-12s %9zu %-12s %9.2f", shape, n, order, m.nanos * per);
+  for (int e = 0; e < PerfCounters::EVENT_COUNT; ++e)
+  {
+    if (counters.available(PerfCounters::Event(e)))
+    {
+      printf(" %13.3f", m.counters[e] * per);
+    }
+    else
+    {
+      printf(" %13s", "n/a");
+    }
+  }
+  printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+  vector<size_t> sizes;
+  for (int i = 1; i < argc; ++i)
+  {
+    sizes.push_back(strtoul(argv[i], nullptr, 10));
+  }
+  if (sizes.empty())
+  {
+    sizes = {1U << 10U, 1U << 16U, 1U << 20U};
+  }
+
+  PerfCounters counters;
+  if (!counters.any_available())
+  {
+    printf("# hardware counters unavailable (check perf_event_paranoid or container seccomp); reporting time only\n");
+  }
+
+  printf("%-12s %9s %-12s %9s", "shape", "n", "order", "ns/elem");
+  for (int e = 0; e < PerfCounters::EVENT_COUNT; ++e)
+  {
+    printf(" %13s", PerfCounters::name(PerfCounters::Event(e)));
+  }
+  printf("\n");
+
+  const vector<pair<Shape, const char *>> shapes = {
+      {Shape::COMPLETE, "complete"},
+      {Shape::RANDOM_SPLIT, "random"},
+      {Shape::LEFT_CHAIN, "left-chain"},
+      {Shape::RIGHT_CHAIN, "right-chain"},
+      {Shape::CATERPILLAR, "caterpillar"}};
+
+  for (const auto &shape : shapes)
+  {
+    for (size_t n : sizes)
+    {
+      TreeGenerator<int> generator(n);
+      BinaryTree<int> tree = generator.values(Values::SHUFFLED).build(shape.first, n);
+
+      report(counters, shape.second, n, "preorder",
+             measure(counters, [&] { return tree.begin_preorder(); }, [&] { return tree.end_preorder(); }));
+      report(counters, shape.second, n, "inorder",
+             measure(counters, [&] { return tree.begin_inorder(); }, [&] { return tree.end_inorder(); }));
+      report(counters, shape.second, n, "postorder",
+             measure(counters, [&] { return tree.begin_postorder(); }, [&] { return tree.end_postorder(); }));
+
+      report(counters, shape.second, n, "stack-pre",
+             measure(counters, [&] { return tree.walk<Walk::PREORDER>().begin(); }, [&] { return tree.walk<Walk::PREORDER>().end(); }));
+      report(counters, shape.second, n, "stack-in",
+             measure(counters, [&] { return tree.walk<Walk::INORDER>().begin(); }, [&] { return tree.walk<Walk::INORDER>().end(); }));
+      report(counters, shape.second, n, "stack-post",
+             measure(counters, [&] { return tree.walk<Walk::POSTORDER>().begin(); }, [&] { return tree.walk<Walk::POSTORDER>().end(); }));
+      report(counters, shape.second, n, "stack-level",
+             measure(counters, [&] { return tree.walk<Walk::LEVEL_ORDER>().begin(); }, [&] { return tree.walk<Walk::LEVEL_ORDER>().end(); }));
+
+      report(counters, shape.second, n, "visit-pre",
+             measureVisitor(counters, [&](auto f) { tree.for_each_preorder(f); }));
+      report(counters, shape.second, n, "visit-in",
+             measureVisitor(counters, [&](auto f) { tree.for_each_inorder(f); }));
+      report(counters, shape.second, n, "visit-post",
+             measureVisitor(counters, [&](auto f) { tree.for_each_postorder(f); }));
+
+      CompactTree<int> compact(tree);
+      report(counters, shape.second, n, "morris-pre",
+             measureVisitor(counters, [&](auto f) { compact.for_each_preorder(f); }));
+      report(counters, shape.second, n, "morris-in",
+             measureVisitor(counters, [&](auto f) { compact.for_each_inorder(f); }));
+      report(counters, shape.second, n, "morris-post",
+             measureVisitor(counters, [&](auto f) { compact.for_each_postorder(f); }));
+    }
+  }
+}
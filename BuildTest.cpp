@@ -0,0 +1,399 @@
+/**
+ * Tests for building a BinaryTree in bulk: TreeGenerator shapes, traversal sequences,
+ * level-order arrays and parent arrays.
+ * Every generated shape is walked with the tree's own iterators, rebuilt from the
+ * sequences and walked again. add_edges batches are checked against the same edits
+ * made one add_left/add_right call at a time, and CompactTree::from_parent_array
+ * against BinaryTree::from_parent_array on the same arrays.
+ */
+
+#include "doctest.h"
+#include "BinaryTree.hpp"
+#include "CompactTree.hpp"
+#include "TreeGenerator.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+using namespace ariel;
+
+namespace
+{
+    using Tree = BinaryTree<int>;
+
+    std::vector<int> walk(Tree &tree, Tree::iterator (Tree::*begin)(), Tree::iterator (Tree::*end)())
+    {
+        std::vector<int> values;
+        for (auto it = (tree.*begin)(); it != (tree.*end)(); ++it)
+        {
+            values.push_back(*it);
+        }
+        return values;
+    }
+
+    std::vector<int> preorder(Tree &tree)
+    {
+        return walk(tree, &Tree::begin_preorder, &Tree::end_preorder);
+    }
+
+    std::vector<int> inorder(Tree &tree)
+    {
+        return walk(tree, &Tree::begin_inorder, &Tree::end_inorder);
+    }
+
+    std::vector<int> postorder(Tree &tree)
+    {
+        return walk(tree, &Tree::begin_postorder, &Tree::end_postorder);
+    }
+
+    struct Measure
+    {
+        std::size_t count = 0;
+        std::size_t depth = 0; // of the deepest node
+    };
+
+    Measure measure(Tree &tree)
+    {
+        Measure m;
+        for (auto it = tree.begin_preorder(); it != tree.end_preorder(); ++it)
+        {
+            ++m.count;
+            m.depth = std::max(m.depth, tree.depth(tree.handle(it)));
+        }
+        return m;
+    }
+
+    const Shape SHAPES[] = {Shape::COMPLETE, Shape::PERFECT, Shape::LEFT_CHAIN, Shape::RIGHT_CHAIN,
+                            Shape::RANDOM_SPLIT, Shape::FIBONACCI, Shape::CATERPILLAR};
+}
+
+TEST_CASE("TreeGenerator builds the requested shape")
+{
+    TreeGenerator<int> generator(11);
+    SUBCASE("chains")
+    {
+        Tree left = generator.left_chain(500);
+        Tree right = generator.right_chain(500);
+        CHECK(measure(left).count == 500);
+        CHECK(measure(left).depth == 499);
+        CHECK(measure(right).count == 500);
+        CHECK(measure(right).depth == 499);
+        CHECK(inorder(left) == postorder(left)); // only left children
+        CHECK(preorder(right) == inorder(right)); // only right children
+    }
+    SUBCASE("perfect and complete")
+    {
+        for (std::size_t height : {0U, 1U, 5U, 9U})
+        {
+            CAPTURE(height);
+            Tree perfect = generator.perfect(height);
+            Measure m = measure(perfect);
+            CHECK(m.count == (std::size_t{2} << height) - 1);
+            CHECK(m.depth == height);
+        }
+        Tree rounded = generator.build(Shape::PERFECT, 100);
+        CHECK(measure(rounded).count == 63);
+        Tree complete = generator.complete(100);
+        CHECK(measure(complete).count == 100);
+        CHECK(measure(complete).depth == 6);
+    }
+    SUBCASE("random split")
+    {
+        for (std::uint64_t seed = 1; seed <= 5; ++seed)
+        {
+            CAPTURE(seed);
+            Tree a = TreeGenerator<int>(seed).build(Shape::RANDOM_SPLIT, 300);
+            Tree b = TreeGenerator<int>(seed).build(Shape::RANDOM_SPLIT, 300);
+            Measure m = measure(a);
+            CHECK(m.count == 300);
+            CHECK(m.depth >= 8); // a tree of 300 nodes is at least this deep
+            CHECK(m.depth <= 299);
+            // same seed, same tree
+            CHECK(preorder(a) == preorder(b));
+            CHECK(inorder(a) == inorder(b));
+        }
+        Tree one = TreeGenerator<int>(1).build(Shape::RANDOM_SPLIT, 300);
+        Tree two = TreeGenerator<int>(2).build(Shape::RANDOM_SPLIT, 300);
+        CHECK(inorder(one) != inorder(two));
+    }
+    SUBCASE("fibonacci and caterpillar")
+    {
+        Tree fibonacci = generator.fibonacci(10);
+        CHECK(measure(fibonacci).count == generator.fibonacci_size(10));
+        CHECK(measure(fibonacci).depth == 9);
+        Tree caterpillar = generator.caterpillar(101);
+        CHECK(measure(caterpillar).count == 101);
+        CHECK(measure(caterpillar).depth == 50);
+    }
+}
+
+TEST_CASE("TreeGenerator builds any tree type through its allocator")
+{
+    struct GeneratorTag;
+    using Counted = AtomicCounters<GeneratorTag>;
+    Counted::reset();
+    {
+        BinaryTree<int, Counted> tree = TreeGenerator<int, BinaryTree<int, Counted>>(4).build(Shape::RANDOM_SPLIT, 120);
+        CHECK(Counted::snapshot().allocations == 120);
+    }
+    CHECK(Counted::snapshot().frees == 120);
+
+    using Summed = AggregateTree<int, SizedAggregate<SumAggregate<int>>>;
+    Summed summed = TreeGenerator<int, Summed>(4).complete(100);
+    CHECK(summed.aggregate().size == 100);
+    CHECK(summed.aggregate().value == 99 * 100 / 2);
+    int middle = 0; // values are numbered in preorder, ranges are inorder positions
+    std::size_t position = 0;
+    for (auto it = summed.begin_inorder(); it != summed.end_inorder(); ++it, ++position)
+    {
+        middle += position >= 10 && position <= 19 ? *it : 0;
+    }
+    CHECK(summed.range_aggregate(10, 19) == middle);
+}
+
+TEST_CASE("from_preorder_inorder and from_postorder_inorder round-trip every shape")
+{
+    for (Shape shape : SHAPES)
+    {
+        for (std::size_t n : {1U, 2U, 3U, 10U, 257U})
+        {
+            CAPTURE(int(shape));
+            CAPTURE(n);
+            Tree source = TreeGenerator<int>(n).values(Values::SHUFFLED).build(shape, n);
+            std::vector<int> pre = preorder(source);
+            std::vector<int> in = inorder(source);
+            std::vector<int> post = postorder(source);
+
+            Tree fromPre = Tree::from_preorder_inorder(pre, in);
+            CHECK(preorder(fromPre) == pre);
+            CHECK(inorder(fromPre) == in);
+            CHECK(postorder(fromPre) == post);
+
+            Tree fromPost = Tree::from_postorder_inorder(post, in);
+            CHECK(preorder(fromPost) == pre);
+            CHECK(inorder(fromPost) == in);
+            CHECK(postorder(fromPost) == post);
+        }
+    }
+}
+
+TEST_CASE("Empty sequences build an empty tree")
+{
+    std::vector<int> none;
+    Tree fromPre = Tree::from_preorder_inorder(none, none);
+    CHECK(preorder(fromPre).empty());
+    Tree fromPost = Tree::from_postorder_inorder(none, none);
+    CHECK(preorder(fromPost).empty());
+}
+
+TEST_CASE("Invalid traversal sequences throw")
+{
+    SUBCASE("duplicate values")
+    {
+        CHECK_THROWS_AS(Tree::from_preorder_inorder(std::vector<int>{1, 2, 1}, std::vector<int>{2, 1, 1}), std::invalid_argument);
+        CHECK_THROWS_AS(Tree::from_postorder_inorder(std::vector<int>{2, 2, 1}, std::vector<int>{2, 1, 2}), std::invalid_argument);
+    }
+    SUBCASE("length mismatch")
+    {
+        CHECK_THROWS_AS(Tree::from_preorder_inorder(std::vector<int>{1, 2, 3}, std::vector<int>{2, 1}), std::invalid_argument);
+        CHECK_THROWS_AS(Tree::from_postorder_inorder(std::vector<int>{2}, std::vector<int>{2, 1}), std::invalid_argument);
+    }
+    SUBCASE("sequences that do not describe one tree")
+    {
+        // inorder puts 3 left of the root and 2 right of it, so preorder would be 1 3 2
+        CHECK_THROWS_AS(Tree::from_preorder_inorder(std::vector<int>{1, 2, 3}, std::vector<int>{3, 1, 2}), std::invalid_argument);
+        CHECK_THROWS_AS(Tree::from_preorder_inorder(std::vector<int>{1, 2, 3}, std::vector<int>{1, 2, 4}), std::invalid_argument);
+        CHECK_THROWS_AS(Tree::from_postorder_inorder(std::vector<int>{1, 2, 3}, std::vector<int>{2, 3, 1}), std::invalid_argument);
+    }
+}
+
+TEST_CASE("from_level_order places nodes by heap index")
+{
+    //        1
+    //     2     3
+    //       5  6
+    Tree tree = Tree::from_level_order(std::vector<int>{1, 2, 3, 0, 5, 6}, 0);
+    CHECK(preorder(tree) == std::vector<int>{1, 2, 5, 3, 6});
+    CHECK(inorder(tree) == std::vector<int>{2, 5, 1, 6, 3});
+
+    SUBCASE("trailing null markers add nothing")
+    {
+        Tree padded = Tree::from_level_order(std::vector<int>{1, 2, 3, 0, 5, 6, 0, 0, 0, 0, 0, 0, 0}, 0);
+        CHECK(preorder(padded) == preorder(tree));
+        CHECK(inorder(padded) == inorder(tree));
+    }
+    SUBCASE("values may repeat")
+    {
+        Tree repeated = Tree::from_level_order(std::vector<int>{7, 7, 7, 7}, 0);
+        CHECK(inorder(repeated) == std::vector<int>{7, 7, 7, 7});
+        CHECK(postorder(repeated) == std::vector<int>{7, 7, 7, 7});
+    }
+    SUBCASE("no values, or only null markers, build an empty tree")
+    {
+        Tree none = Tree::from_level_order(std::vector<int>{}, 0);
+        Tree nulls = Tree::from_level_order(std::vector<int>{0, 0, 0}, 0);
+        CHECK(preorder(none).empty());
+        CHECK(preorder(nulls).empty());
+    }
+    SUBCASE("a node below a null marker throws")
+    {
+        CHECK_THROWS_AS(Tree::from_level_order(std::vector<int>{1, 0, 3, 4}, 0), std::invalid_argument);
+        CHECK_THROWS_AS(Tree::from_level_order(std::vector<int>{0, 2}, 0), std::invalid_argument);
+    }
+}
+
+TEST_CASE("from_parent_array links nodes by index")
+{
+    //        1
+    //     2     3
+    //       4
+    std::vector<int> values{4, 3, 1, 2};
+    Tree tree = Tree::from_parent_array(values, std::vector<int>{3, 2, -1, 2}, std::vector<bool>{false, false, false, true});
+    CHECK(preorder(tree) == std::vector<int>{1, 2, 4, 3});
+    CHECK(inorder(tree) == std::vector<int>{2, 4, 1, 3});
+
+    SUBCASE("arrays that are not one tree throw")
+    {
+        std::vector<bool> sides{true, true, true, true};
+        // lengths differ
+        CHECK_THROWS_AS(Tree::from_parent_array(values, std::vector<int>{-1, 0, 0}, sides), std::invalid_argument);
+        // two roots
+        CHECK_THROWS_AS(Tree::from_parent_array(values, std::vector<int>{-1, 0, -1, 1}, sides), std::invalid_argument);
+        // no root: every node hangs in a cycle
+        CHECK_THROWS_AS(Tree::from_parent_array(values, std::vector<int>{1, 2, 3, 0}, sides), std::invalid_argument);
+        // a cycle beside the root
+        CHECK_THROWS_AS(Tree::from_parent_array(values, std::vector<int>{-1, 2, 3, 1}, sides), std::invalid_argument);
+        // a parent index past the end
+        CHECK_THROWS_AS(Tree::from_parent_array(values, std::vector<int>{-1, 0, 4, 1}, sides), std::invalid_argument);
+        // two left children of node 0
+        CHECK_THROWS_AS(Tree::from_parent_array(values, std::vector<int>{-1, 0, 0, 1}, sides), std::invalid_argument);
+    }
+}
+
+TEST_CASE("add_edges matches sequential add_left and add_right")
+{
+    using edge = Tree::edge;
+
+    SUBCASE("renaming a node moves its value to the next node holding it")
+    {
+        Tree batch;
+        batch.add_root(0).add_left(0, 5).add_right(0, 5);
+        Tree sequential;
+        sequential.add_root(0).add_left(0, 5).add_right(0, 5);
+        batch.add_edges(std::vector<edge>{{0, 7, Side::LEFT}, {5, 9, Side::LEFT}});
+        sequential.add_left(0, 7).add_left(5, 9);
+        CHECK(preorder(batch) == std::vector<int>{0, 7, 5, 9});
+        CHECK(preorder(batch) == preorder(sequential));
+        CHECK(inorder(batch) == inorder(sequential));
+    }
+    SUBCASE("edits wait for the edit that creates their parent")
+    {
+        Tree tree;
+        tree.add_root(1);
+        tree.add_edges(std::vector<edge>{{4, 8, Side::LEFT}, {2, 4, Side::LEFT}, {1, 2, Side::LEFT}, {2, 5, Side::RIGHT}, {1, 3, Side::RIGHT}});
+        CHECK(preorder(tree) == std::vector<int>{1, 2, 4, 8, 5, 3});
+        CHECK(inorder(tree) == std::vector<int>{8, 4, 2, 5, 1, 3});
+    }
+    SUBCASE("edits that never resolve throw after the others are applied")
+    {
+        Tree tree;
+        tree.add_root(1);
+        CHECK_THROWS_AS(tree.add_edges(std::vector<edge>{{6, 7, Side::LEFT}, {1, 2, Side::RIGHT}}), std::invalid_argument);
+        CHECK(preorder(tree) == std::vector<int>{1, 2});
+    }
+    SUBCASE("random batches over repeated values")
+    {
+        for (unsigned seed = 1; seed <= 20; ++seed)
+        {
+            CAPTURE(seed);
+            // the copy constructor re-adds by value, which does not keep a shape with repeats
+            Tree batch = TreeGenerator<int>(seed).values(Values::DUPLICATES).build(Shape::RANDOM_SPLIT, 60);
+            Tree sequential = TreeGenerator<int>(seed).values(Values::DUPLICATES).build(Shape::RANDOM_SPLIT, 60);
+            std::vector<int> parents = preorder(batch);
+            std::vector<edge> edges;
+            for (std::size_t i = 0; i < 40; ++i)
+            {
+                // children get fresh values, so only renames and repeated parents interact
+                int parent = parents[(i * 7 + seed) % parents.size()];
+                edges.push_back({parent, 1000 + int(i), i % 2 == 0 ? Side::LEFT : Side::RIGHT});
+            }
+            for (const edge &e : edges)
+            {
+                if (e.side == Side::LEFT)
+                {
+                    sequential.try_add_left(e.parent, e.child);
+                }
+                else
+                {
+                    sequential.try_add_right(e.parent, e.child);
+                }
+            }
+            try
+            {
+                batch.add_edges(edges);
+            }
+            catch (const std::invalid_argument &)
+            {
+                // a parent value renamed away on every node; sequential calls skipped it too
+            }
+            CHECK(preorder(batch) == preorder(sequential));
+            CHECK(inorder(batch) == inorder(sequential));
+        }
+    }
+}
+
+TEST_CASE("CompactTree::from_parent_array loads the tree BinaryTree::from_parent_array builds")
+{
+    for (Shape shape : SHAPES)
+    {
+        CAPTURE(int(shape));
+        // repeated values, which only the parent array can place
+        Tree source = TreeGenerator<int>(7).values(Values::DUPLICATES).build(shape, 88);
+        std::vector<int> values;
+        std::vector<int> parents;
+        std::vector<bool> isLeft;
+        std::unordered_map<const Tree::node_type *, int> number;
+        for (auto it = source.begin_postorder(); it != source.end_postorder(); ++it)
+        {
+            number.emplace(&it.Node(), int(number.size()));
+        }
+        for (auto it = source.begin_postorder(); it != source.end_postorder(); ++it)
+        {
+            const Tree::node_type *node = &it.Node();
+            values.push_back(node->_value);
+            parents.push_back(node->_parent == nullptr ? -1 : number.at(node->_parent));
+            isLeft.push_back(node->_parent != nullptr && node->_parent->_left == node);
+        }
+
+        Tree tree = Tree::from_parent_array(values, parents, isLeft);
+        CompactTree<int> compact = CompactTree<int>::from_parent_array(values, parents, isLeft);
+        CHECK(compact.size() == values.size());
+        std::vector<int> pre;
+        std::vector<int> in;
+        std::vector<int> post;
+        compact.for_each_preorder([&pre](int value) { pre.push_back(value); });
+        compact.for_each_inorder([&in](int value) { in.push_back(value); });
+        compact.for_each_postorder([&post](int value) { post.push_back(value); });
+        CHECK(pre == preorder(tree));
+        CHECK(in == inorder(tree));
+        CHECK(post == postorder(tree));
+        CHECK(post == values);
+    }
+}
+
+TEST_CASE("CompactTree::from_parent_array rejects arrays that are not one tree")
+{
+    using Compact = CompactTree<int>;
+    std::vector<int> values{1, 2, 3};
+    CHECK(Compact::from_parent_array(std::vector<int>{}, std::vector<int>{}, std::vector<bool>{}).size() == 0);
+    CHECK_THROWS_AS(Compact::from_parent_array(values, std::vector<int>{-1, 0}, std::vector<bool>{false, true}), std::invalid_argument);
+    CHECK_THROWS_AS(Compact::from_parent_array(values, std::vector<int>{-1, 0, -1}, std::vector<bool>{false, true, true}), std::invalid_argument);
+    CHECK_THROWS_AS(Compact::from_parent_array(values, std::vector<int>{-1, 0, 3}, std::vector<bool>{false, true, true}), std::invalid_argument);
+    CHECK_THROWS_AS(Compact::from_parent_array(values, std::vector<int>{-1, 0, 0}, std::vector<bool>{false, true, true}), std::invalid_argument);
+    // 1 and 2 are each other's parent, so neither is reachable from the root
+    CHECK_THROWS_AS(Compact::from_parent_array(values, std::vector<int>{-1, 2, 1}, std::vector<bool>{false, true, true}), std::invalid_argument);
+    CHECK_THROWS_AS(Compact::from_parent_array(values, std::vector<int>{1, 2, 0}, std::vector<bool>{true, true, true}), std::invalid_argument);
+}
@@ -0,0 +1,118 @@
+/**
+ * Tests for the AtomicCounters policy: what each hook counts on a small tree, and
+ * snapshot(), reset() and the independence of counter sets with different Tags.
+ */
+
+#include "doctest.h"
+#include "BinaryTree.hpp"
+#include "Counters.hpp"
+
+#include <cstdint>
+using namespace ariel;
+
+namespace
+{
+    struct FirstTag;
+    struct SecondTag;
+    using First = AtomicCounters<FirstTag>;
+    using Second = AtomicCounters<SecondTag>;
+
+    //       1
+    //    2     3
+    //  4   5
+    template <typename Counters>
+    void sample(BinaryTree<int, Counters> &tree)
+    {
+        tree.add_root(1).add_left(1, 2).add_right(1, 3).add_left(2, 4).add_right(2, 5);
+    }
+}
+
+TEST_CASE("AtomicCounters count finds, allocations and frees")
+{
+    First::reset();
+    {
+        BinaryTree<int, First> tree;
+        sample(tree);
+        CounterSnapshot built = First::snapshot();
+        CHECK(built.allocations == 5);
+        CHECK(built.frees == 0);
+        CHECK(built.hops == 0);
+
+        SUBCASE("find visits the nodes up to the match in preorder")
+        {
+            tree.find(5);
+            CHECK(First::snapshot().find_visits - built.find_visits == 4);
+            CHECK(First::snapshot().max_depth == 3);
+            tree.find(3);
+            CHECK(First::snapshot().find_visits - built.find_visits == 9);
+            CHECK_FALSE(tree.contains(6));
+            CHECK(First::snapshot().find_visits - built.find_visits == 14);
+            CHECK(First::snapshot().max_depth == 3);
+        }
+        SUBCASE("iterator steps count their hops")
+        {
+            std::uint64_t visited = 0;
+            for (auto it = tree.begin_preorder(); it != tree.end_preorder(); ++it)
+            {
+                ++visited;
+            }
+            CHECK(visited == 5);
+            // each of the 4 edges is walked down once and at most once back up
+            CHECK(First::snapshot().hops >= 4);
+            CHECK(First::snapshot().hops <= 8);
+            CHECK(First::snapshot().allocations == 5);
+        }
+        SUBCASE("released nodes are reused before allocating")
+        {
+            tree.erase_subtree(tree.find(2));
+            tree.add_left(1, 6).add_left(6, 7);
+            tree.add_left(1, 8); // renames 6 in place
+            CHECK(First::snapshot().allocations == 5);
+            tree.add_right(7, 9).add_left(7, 10);
+            CHECK(First::snapshot().allocations == 6);
+            CHECK(First::snapshot().frees == 0);
+        }
+    }
+    CHECK(First::snapshot().frees == First::snapshot().allocations);
+}
+
+TEST_CASE("AtomicCounters snapshot, reset and Tags")
+{
+    First::reset();
+    Second::reset();
+    {
+        BinaryTree<int, First> first;
+        sample(first);
+        first.find(5);
+        CounterSnapshot snapshot = First::snapshot();
+        CHECK(snapshot.allocations == 5);
+        CHECK(snapshot.find_visits > 0);
+
+        // another Tag is another counter set
+        CounterSnapshot untouched = Second::snapshot();
+        CHECK(untouched.allocations == 0);
+        CHECK(untouched.find_visits == 0);
+        CHECK(untouched.max_depth == 0);
+
+        BinaryTree<int, Second> second;
+        second.add_root(1);
+        CHECK(Second::snapshot().allocations == 1);
+        CHECK(First::snapshot().allocations == 5);
+
+        // a snapshot is a copy: later counts do not change it
+        first.find(3);
+        CHECK(First::snapshot().find_visits > snapshot.find_visits);
+        CHECK(snapshot.allocations == 5);
+
+        First::reset();
+        CounterSnapshot cleared = First::snapshot();
+        CHECK(cleared.find_visits == 0);
+        CHECK(cleared.hops == 0);
+        CHECK(cleared.allocations == 0);
+        CHECK(cleared.frees == 0);
+        CHECK(cleared.max_depth == 0);
+        CHECK(Second::snapshot().allocations == 1);
+    }
+    CHECK(First::snapshot().frees == 5);
+    CHECK(Second::snapshot().frees == 1);
+}
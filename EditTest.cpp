@@ -0,0 +1,369 @@
+/**
+ * Tests for editing a BinaryTree at handles and iterators: insert_left, insert_right,
+ * replace, extract_subtree, graft_left, graft_right and erase_subtree, including the rejection of stale handles and of
+ * handles to nodes that belong to another tree, and the Merkle hashes that == and
+ * diff rely on staying current through those edits. Subtree-scoped begin_* walks
+ * are checked on the same sample trees.
+ */
+
+#include "doctest.h"
+#include "BinaryTree.hpp"
+
+#include <stdexcept>
+#include <vector>
+using namespace ariel;
+
+namespace
+{
+    template <typename Tree>
+    std::vector<int> preorder(Tree &tree)
+    {
+        std::vector<int> values;
+        for (auto it = tree.begin_preorder(); it != tree.end_preorder(); ++it)
+        {
+            values.push_back(*it);
+        }
+        return values;
+    }
+
+    template <typename Tree>
+    std::vector<int> walk(typename Tree::iterator it, typename Tree::iterator end)
+    {
+        std::vector<int> values;
+        for (; it != end; ++it)
+        {
+            values.push_back(*it);
+        }
+        return values;
+    }
+
+    //       1
+    //    2     3
+    //  4   5
+    template <typename Tree = BinaryTree<int>>
+    Tree sample()
+    {
+        Tree tree;
+        tree.add_root(1).add_left(1, 2).add_right(1, 3).add_left(2, 4).add_right(2, 5);
+        return tree;
+    }
+}
+
+TEST_CASE("begin_* at a node walks only its subtree")
+{
+    using Tree = BinaryTree<int>;
+    Tree tree = sample();
+    tree.add_left(3, 6);
+    auto two = tree.handle(tree.find(2));
+
+    CHECK(walk<Tree>(tree.begin_preorder(two), tree.end_preorder()) == std::vector<int>{2, 4, 5});
+    CHECK(walk<Tree>(tree.begin_inorder(two), tree.end_inorder()) == std::vector<int>{4, 2, 5});
+    CHECK(walk<Tree>(tree.begin_postorder(two), tree.end_postorder()) == std::vector<int>{4, 5, 2});
+
+    CHECK(walk<Tree>(tree.begin_preorder(tree.find(3)), tree.end_preorder()) == std::vector<int>{3, 6});
+    CHECK(walk<Tree>(tree.begin_inorder(tree.find(3)), tree.end_inorder()) == std::vector<int>{6, 3});
+    CHECK(walk<Tree>(tree.begin_postorder(tree.find(3)), tree.end_postorder()) == std::vector<int>{6, 3});
+
+    CHECK(walk<Tree>(tree.begin_preorder(tree.find(5)), tree.end_preorder()) == std::vector<int>{5});
+    CHECK(walk<Tree>(tree.begin_preorder(tree.root_handle()), tree.end_preorder()) == preorder(tree));
+}
+
+TEST_CASE("insert_left, insert_right and replace edit at an iterator position")
+{
+    BinaryTree<int> tree = sample();
+    auto two = tree.handle(tree.find(2));
+
+    // the root is where preorder begins; its existing left child keeps its node
+    auto renamed = tree.insert_left(tree.begin_preorder(), 7);
+    CHECK(renamed == two);
+    CHECK(preorder(tree) == std::vector<int>{1, 7, 4, 5, 3});
+
+    // 4 is where inorder begins
+    CHECK(tree.value(tree.insert_right(tree.begin_inorder(), 8)) == 8);
+    CHECK(preorder(tree) == std::vector<int>{1, 7, 4, 8, 5, 3});
+
+    // postorder now begins at 8, the deepest node on the left
+    tree.insert_left(tree.begin_postorder(), 9);
+    CHECK(preorder(tree) == std::vector<int>{1, 7, 4, 8, 9, 5, 3});
+
+    tree.replace(tree.find(3), 6);
+    CHECK(preorder(tree) == std::vector<int>{1, 7, 4, 8, 9, 5, 6});
+    CHECK_THROWS_AS(tree.insert_left(tree.end_preorder(), 1), std::invalid_argument);
+}
+
+TEST_CASE("Edits at an iterator refresh the aggregates above it")
+{
+    using Tree = AggregateTree<int, SumAggregate<int>>;
+    Tree tree = sample<Tree>();
+    REQUIRE(tree.aggregate() == 15);
+    tree.replace(tree.find(4), 40);
+    CHECK(tree.aggregate() == 51);
+    CHECK(tree.aggregate(tree.find(2)) == 47);
+    tree.insert_right(tree.find(3), 10);
+    CHECK(tree.aggregate() == 61);
+    CHECK(tree.aggregate(tree.find(3)) == 13);
+    tree.insert_left(tree.find(2), 1); // renames 40 to 1
+    CHECK(tree.aggregate() == 22);
+    CHECK(tree.aggregate(tree.find(2)) == 8);
+}
+
+TEST_CASE("Subtree aggregates stay current through every kind of edit")
+{
+    using Tree = AggregateTree<int, SumAggregate<int>>;
+    using Counted = AggregateTree<int, CountAggregate>;
+    Tree tree = sample<Tree>();
+    Counted counted = sample<Counted>();
+    auto two = tree.handle(tree.find(2));
+    CHECK(tree.aggregate() == 15);
+    CHECK(tree.aggregate(two) == 11);
+    CHECK(counted.aggregate() == 5);
+
+    SUBCASE("add_left, add_right and add_root")
+    {
+        tree.add_left(3, 6).add_right(4, 7);
+        CHECK(tree.aggregate() == 28);
+        CHECK(tree.aggregate(two) == 18);
+        CHECK(tree.aggregate(tree.find(3)) == 9);
+        auto eight = tree.add_right(two, 8); // renames 5
+        CHECK(tree.aggregate(eight) == 8);
+        CHECK(tree.aggregate(two) == 21);
+        tree.add_root(10);
+        CHECK(tree.aggregate() == 40);
+        counted.add_left(3, 6).add_left(1, 9); // one new node, one rename
+        CHECK(counted.aggregate() == 6);
+    }
+    SUBCASE("replace")
+    {
+        tree.replace(tree.handle(tree.find(5)), 50);
+        CHECK(tree.aggregate(two) == 56);
+        CHECK(tree.aggregate() == 60);
+        CHECK(tree.aggregate(tree.find(3)) == 3);
+    }
+    SUBCASE("erase_subtree")
+    {
+        CHECK(tree.erase_subtree(tree.find(4)) == 1);
+        CHECK(tree.aggregate(two) == 7);
+        CHECK(tree.aggregate() == 11);
+        counted.erase_subtree(counted.find(2));
+        CHECK(counted.aggregate() == 2);
+        tree.erase_subtree(tree.find(1));
+        CHECK(tree.aggregate() == 0);
+    }
+    SUBCASE("extract_subtree and graft")
+    {
+        Tree sub = tree.extract_subtree(two);
+        CHECK(tree.aggregate() == 4);
+        CHECK(sub.aggregate() == 11);
+        CHECK(sub.aggregate(two) == 11);
+
+        auto three = tree.handle(tree.find(3));
+        tree.graft_right(three, std::move(sub));
+        CHECK(tree.aggregate(three) == 14);
+        CHECK(tree.aggregate() == 15);
+        CHECK(sub.aggregate() == 0);
+
+        // grafting over a subtree releases it and drops it from the sums
+        Tree replacement;
+        replacement.add_root(100);
+        tree.graft_right(three, std::move(replacement));
+        CHECK(tree.aggregate(three) == 103);
+        CHECK(tree.aggregate() == 104);
+    }
+}
+
+TEST_CASE("Edits at an iterator into another tree are rejected")
+{
+    BinaryTree<int> tree = sample();
+    BinaryTree<int> other = sample();
+    auto inOther = other.find(3);
+    CHECK_THROWS_AS(tree.insert_left(inOther, 9), std::invalid_argument);
+    CHECK_THROWS_AS(tree.insert_right(inOther, 9), std::invalid_argument);
+    CHECK_THROWS_AS(tree.replace(inOther, 9), std::invalid_argument);
+    CHECK(preorder(other) == std::vector<int>{1, 2, 4, 5, 3});
+
+    auto four = tree.find(4);
+    BinaryTree<int> sub = tree.extract_subtree(tree.find(2));
+    CHECK_THROWS_AS(tree.replace(four, 9), std::invalid_argument);
+    CHECK_THROWS_AS(tree.insert_left(four, 9), std::invalid_argument);
+    sub.replace(four, 9);
+    CHECK(preorder(sub) == std::vector<int>{2, 9, 5});
+}
+
+TEST_CASE("extract_subtree moves the subtree and keeps its handles")
+{
+    BinaryTree<int> tree = sample();
+    auto four = tree.handle(tree.find(4));
+    BinaryTree<int> sub = tree.extract_subtree(tree.find(2));
+
+    CHECK(preorder(tree) == std::vector<int>{1, 3});
+    CHECK(preorder(sub) == std::vector<int>{2, 4, 5});
+    CHECK(sub.valid(four));
+    CHECK(sub.value(four) == 4);
+    CHECK_FALSE(tree.contains(4));
+
+    BinaryTree<int> whole = tree.extract_subtree(tree.root_handle());
+    CHECK(preorder(tree).empty());
+    CHECK(preorder(whole) == std::vector<int>{1, 3});
+}
+
+TEST_CASE("graft_left and graft_right attach a tree and release what they replace")
+{
+    BinaryTree<int> tree = sample();
+    auto three = tree.handle(tree.find(3));
+    BinaryTree<int> sub;
+    sub.add_root(6).add_left(6, 7);
+
+    auto grafted = tree.graft_left(three, std::move(sub));
+    CHECK(tree.value(grafted) == 6);
+    CHECK(preorder(tree) == std::vector<int>{1, 2, 4, 5, 3, 6, 7});
+    CHECK(preorder(sub).empty());
+
+    auto two = tree.handle(tree.find(2));
+    BinaryTree<int> replacement;
+    replacement.add_root(8);
+    tree.graft_left(tree.root_handle(), std::move(replacement));
+    CHECK(preorder(tree) == std::vector<int>{1, 8, 3, 6, 7});
+    CHECK_FALSE(tree.valid(two));
+
+    BinaryTree<int> empty;
+    CHECK_FALSE(tree.valid(tree.graft_right(tree.root_handle(), std::move(empty))));
+    CHECK(preorder(tree) == std::vector<int>{1, 8});
+}
+
+TEST_CASE("Handles follow their node into the tree that now holds it")
+{
+    BinaryTree<int> tree = sample();
+    auto two = tree.handle(tree.find(2));
+    auto five = tree.handle(tree.find(5));
+
+    BinaryTree<int> sub = tree.extract_subtree(two);
+    CHECK(sub.depth(five) == 1);
+    CHECK_THROWS_AS(tree.depth(five), std::invalid_argument);
+    CHECK_THROWS_AS(tree.ancestors(five), std::invalid_argument);
+    auto six = sub.add_left(five, 6);
+    sub.replace(two, 20);
+    CHECK(preorder(sub) == std::vector<int>{20, 4, 5, 6});
+
+    BinaryTree<int> target;
+    target.add_root(0);
+    target.graft_right(target.root_handle(), std::move(sub));
+    CHECK(target.valid(six));
+    CHECK(target.depth(six) == 3);
+    CHECK_THROWS_AS(sub.depth(six), std::invalid_argument);
+    std::vector<int> path;
+    for (int value : target.ancestors(six))
+    {
+        path.push_back(value);
+    }
+    CHECK(path == std::vector<int>{6, 5, 20, 0});
+    target.add_right(six, 7);
+    CHECK(preorder(target) == std::vector<int>{0, 20, 4, 5, 6, 7});
+}
+
+TEST_CASE("Stale and foreign handles are rejected")
+{
+    BinaryTree<int> tree = sample();
+    auto two = tree.handle(tree.find(2));
+    auto five = tree.handle(tree.find(5));
+    BinaryTree<int> sub = tree.extract_subtree(two);
+
+    SUBCASE("a node already extracted")
+    {
+        CHECK_THROWS_AS(tree.extract_subtree(two), std::invalid_argument);
+        CHECK_THROWS_AS(tree.extract_subtree(five), std::invalid_argument);
+        CHECK(preorder(tree) == std::vector<int>{1, 3});
+        CHECK(preorder(sub) == std::vector<int>{2, 4, 5});
+    }
+    SUBCASE("grafting a tree below one of its own nodes")
+    {
+        CHECK_THROWS_AS(tree.graft_right(five, std::move(sub)), std::invalid_argument);
+        CHECK(preorder(sub) == std::vector<int>{2, 4, 5});
+        std::vector<int> path;
+        for (int value : sub.ancestors(five))
+        {
+            path.push_back(value);
+        }
+        CHECK(path == std::vector<int>{5, 2});
+    }
+    SUBCASE("erasing through an iterator into another tree")
+    {
+        CHECK_THROWS_AS(tree.erase_subtree(sub.find(4)), std::invalid_argument);
+        CHECK(preorder(sub) == std::vector<int>{2, 4, 5});
+    }
+    SUBCASE("grafting a tree onto itself")
+    {
+        CHECK_THROWS_AS(tree.graft_left(tree.root_handle(), std::move(tree)), std::invalid_argument);
+    }
+    SUBCASE("handles to erased nodes")
+    {
+        auto four = sub.handle(sub.find(4));
+        CHECK(sub.erase_subtree(sub.find(4)) == 1);
+        CHECK_FALSE(sub.valid(four));
+        CHECK_THROWS_AS(sub.value(four), std::invalid_argument);
+        CHECK_THROWS_AS(sub.extract_subtree(four), std::invalid_argument);
+        CHECK_THROWS_AS(sub.add_left(four, 9), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Merkle hashes follow replace, erase_subtree and graft")
+{
+    using Tree = MerkleTree<int>;
+    Tree a = sample<Tree>();
+    Tree b = sample<Tree>();
+    REQUIRE(a == b);
+    REQUIRE(diff(a, b).empty());
+
+    SUBCASE("replace")
+    {
+        a.replace(a.find(4), 9);
+        CHECK(a != b);
+        auto changes = diff(a, b);
+        REQUIRE(changes.size() == 1);
+        CHECK(a.value(changes[0].left) == 9);
+        CHECK(b.value(changes[0].right) == 4);
+
+        a.replace(a.find(9), 4);
+        CHECK(a == b);
+        CHECK(diff(a, b).empty());
+    }
+    SUBCASE("erase_subtree")
+    {
+        CHECK(a.erase_subtree(a.find(2)) == 3);
+        CHECK(a != b);
+        auto changes = diff(a, b);
+        REQUIRE(changes.size() == 1);
+        CHECK_FALSE(a.valid(changes[0].left));
+        CHECK(b.value(changes[0].right) == 2);
+
+        CHECK(b.erase_subtree(b.find(2)) == 3);
+        CHECK(a == b);
+        CHECK(diff(a, b).empty());
+    }
+    SUBCASE("graft")
+    {
+        Tree moved = a.extract_subtree(a.find(2));
+        CHECK(a != b);
+        a.graft_right(a.find(3), std::move(moved));
+        auto changes = diff(a, b);
+        REQUIRE(changes.size() == 2);
+        CHECK(b.value(changes[0].right) == 2);
+        CHECK(a.value(changes[1].left) == 2);
+
+        Tree back = a.extract_subtree(a.find(2));
+        a.graft_left(a.root_handle(), std::move(back));
+        CHECK(a == b);
+        CHECK(diff(a, b).empty());
+    }
+    SUBCASE("trees equal after different edits")
+    {
+        // the same shape and values reached by different routes hash the same
+        a.replace(a.find(5), 6);
+        b.erase_subtree(b.find(5));
+        b.add_right(2, 6);
+        CHECK(a == b);
+        CHECK(diff(a, b).empty());
+        b.add_left(6, 7);
+        CHECK(a != b);
+        REQUIRE(diff(a, b).size() == 1);
+    }
+}
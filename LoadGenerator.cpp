@@ -0,0 +1,329 @@
+/**
+ * Load generator for BinaryTree.
+ * Every thread owns a tree of the requested shape and size and runs a weighted
+ * mix of operations against it until the duration elapses, then reports the
+ * throughput and latency percentiles of every operation.
+ *
+ * Usage: ./loadgen [--size N] [--shape complete|perfect|left-chain|right-chain|random|fibonacci|caterpillar]
+ *                  [--type int|string] [--ops build:1,lookup:10,preorder:1,inorder:1,postorder:1,copy:1]
+ *                  [--threads T (at most 1024)] [--duration SECONDS] [--seed S]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+#include "BinaryTree.hpp"
+#include "TreeGenerator.hpp"
+using namespace ariel;
+
+enum Operation
+{
+  BUILD,
+  LOOKUP,
+  PREORDER,
+  INORDER,
+  POSTORDER,
+  COPY,
+  OPERATION_COUNT
+};
+
+static const char *OPERATION_NAMES[OPERATION_COUNT] = {"build", "lookup", "preorder", "inorder", "postorder", "copy"};
+
+struct Options
+{
+  size_t size = 1000;
+  Shape shape = Shape::COMPLETE;
+  string type = "int";
+  vector<unsigned> weights = {1, 10, 1, 1, 1, 1};
+  unsigned threads = 1;
+  double duration = 5;
+  unsigned long seed = 1;
+};
+
+static const unsigned MAX_THREADS = 1024;
+
+using Clock = chrono::steady_clock;
+using Latencies = vector<vector<double>>; // nanoseconds, indexed by Operation
+
+static Shape parseShape(const string &name)
+{
+  const map<string, Shape> shapes = {
+      {"complete", Shape::COMPLETE}, {"perfect", Shape::PERFECT}, {"left-chain", Shape::LEFT_CHAIN}, {"right-chain", Shape::RIGHT_CHAIN}, {"random", Shape::RANDOM_SPLIT}, {"fibonacci", Shape::FIBONACCI}, {"caterpillar", Shape::CATERPILLAR}};
+  auto it = shapes.find(name);
+  if (it == shapes.end())
+  {
+    throw invalid_argument("unknown shape: " + name);
+  }
+  return it->second;
+}
+
+/*
+ * stoul skips leading blanks, wraps negative numbers and ignores trailing characters,
+ * so the whole text must be digits and the result at most max.
+ */
+static unsigned long parseNumber(const string &what, const string &text, unsigned long max)
+{
+  if (text.empty() || !all_of(text.begin(), text.end(), [](char c) { return c >= '0' && c <= '9'; }))
+  {
+    throw invalid_argument("not a non-negative integer for " + what + ": " + text);
+  }
+  string tooLarge = "value too large for " + what + ": " + text;
+  unsigned long number = 0;
+  try
+  {
+    number = stoul(text);
+  }
+  catch (const out_of_range &)
+  {
+    throw invalid_argument(tooLarge);
+  }
+  if (number > max)
+  {
+    throw invalid_argument(tooLarge);
+  }
+  return number;
+}
+
+static vector<unsigned> parseOps(const string &spec)
+{
+  vector<unsigned> weights(OPERATION_COUNT, 0);
+  size_t start = 0;
+  while (start < spec.size())
+  {
+    size_t comma = spec.find(',', start);
+    string item = spec.substr(start, comma == string::npos ? string::npos : comma - start);
+    size_t colon = item.find(':');
+    string name = item.substr(0, colon);
+    unsigned weight = colon == string::npos ? 1 : unsigned(parseNumber("weight of " + name, item.substr(colon + 1), UINT_MAX));
+    auto op = find(begin(OPERATION_NAMES), end(OPERATION_NAMES), name);
+    if (op == end(OPERATION_NAMES))
+    {
+      throw invalid_argument("unknown operation: " + name);
+    }
+    weights[size_t(op - begin(OPERATION_NAMES))] = weight;
+    start = comma == string::npos ? spec.size() : comma + 1;
+  }
+  if (all_of(weights.begin(), weights.end(), [](unsigned weight) { return weight == 0; }))
+  {
+    throw invalid_argument("operation mix has no weight: " + spec);
+  }
+  return weights;
+}
+
+static Options parseOptions(int argc, char **argv)
+{
+  Options options;
+  for (int i = 1; i < argc; i += 2)
+  {
+    string flag = argv[i];
+    if (i + 1 == argc)
+    {
+      throw invalid_argument("missing value for " + flag);
+    }
+    string value = argv[i + 1];
+    if (flag == "--size")
+    {
+      options.size = parseNumber(flag, value, ULONG_MAX);
+    }
+    else if (flag == "--shape")
+    {
+      options.shape = parseShape(value);
+    }
+    else if (flag == "--type")
+    {
+      options.type = value;
+    }
+    else if (flag == "--ops")
+    {
+      options.weights = parseOps(value);
+    }
+    else if (flag == "--threads")
+    {
+      options.threads = unsigned(parseNumber(flag, value, MAX_THREADS));
+    }
+    else if (flag == "--duration")
+    {
+      size_t end = 0;
+      options.duration = stod(value, &end);
+      if (end != value.size() || !(options.duration > 0) || !isfinite(options.duration))
+      {
+        throw invalid_argument("not a positive number of seconds for " + flag + ": " + value);
+      }
+    }
+    else if (flag == "--seed")
+    {
+      options.seed = parseNumber(flag, value, ULONG_MAX);
+    }
+    else
+    {
+      throw invalid_argument("unknown flag: " + flag);
+    }
+  }
+  if (options.size == 0 || options.threads == 0)
+  {
+    throw invalid_argument("size and threads must be positive");
+  }
+  return options;
+}
+
+/*
+ * Builds the tree through the public API, the way clients do:
+ * node i becomes a child of node (i - 1) / 2.
+ */
+template <typename T>
+static void build(size_t size)
+{
+  value_of<T> value;
+  BinaryTree<T> tree;
+  tree.add_root(value(0));
+  for (size_t i = 1; i < size; ++i)
+  {
+    if (i % 2 == 1)
+    {
+      tree.add_left(value((i - 1) / 2), value(i));
+    }
+    else
+    {
+      tree.add_right(value((i - 1) / 2), value(i));
+    }
+  }
+}
+
+template <typename T>
+static size_t walk(BinaryTree<T> &tree, typename BinaryTree<T>::iterator (BinaryTree<T>::*begin)(), typename BinaryTree<T>::iterator (BinaryTree<T>::*end)())
+{
+  size_t count = 0;
+  for (auto it = (tree.*begin)(); it != (tree.*end)(); ++it)
+  {
+    ++count;
+  }
+  return count;
+}
+
+template <typename T>
+static void worker(const Options &options, unsigned id, Latencies &latencies)
+{
+  TreeGenerator<T> generator(options.seed + id);
+  BinaryTree<T> tree = generator.values(Values::SHUFFLED).build(options.shape, options.size);
+  mt19937_64 rng(options.seed * 31 + id);
+  discrete_distribution<int> pick(options.weights.begin(), options.weights.end());
+  uniform_int_distribution<size_t> key(0, options.size - 1);
+  value_of<T> value;
+  using Tree = BinaryTree<T>;
+
+  size_t sink = 0;
+  auto deadline = Clock::now() + chrono::duration_cast<Clock::duration>(chrono::duration<double>(options.duration));
+  while (Clock::now() < deadline)
+  {
+    auto op = Operation(pick(rng));
+    T probe = value(key(rng));
+    auto start = Clock::now();
+    switch (op)
+    {
+    case BUILD:
+      build<T>(options.size);
+      break;
+    case LOOKUP:
+      sink += tree.contains(probe) ? 1U : 0U;
+      break;
+    case PREORDER:
+      sink += walk(tree, &Tree::begin_preorder, &Tree::end_preorder);
+      break;
+    case INORDER:
+      sink += walk(tree, &Tree::begin_inorder, &Tree::end_inorder);
+      break;
+    case POSTORDER:
+      sink += walk(tree, &Tree::begin_postorder, &Tree::end_postorder);
+      break;
+    case COPY:
+    {
+      Tree copy(tree);
+      sink += copy.begin_preorder() != copy.end_preorder() ? 1U : 0U;
+      break;
+    }
+    case OPERATION_COUNT:
+      break;
+    }
+    latencies[op].push_back(chrono::duration<double, nano>(Clock::now() - start).count());
+  }
+  if (sink == 0)
+  {
+    printf("# no work done by thread %u\n", id);
+  }
+}
+
+static double percentile(const vector<double> &sorted, double p)
+{
+  size_t index = size_t(p * double(sorted.size() - 1));
+  return sorted[index];
+}
+
+template <typename T>
+static void run(const Options &options)
+{
+  vector<Latencies> perThread(options.threads, Latencies(OPERATION_COUNT));
+  vector<thread> threads;
+  auto start = Clock::now();
+  for (unsigned id = 0; id < options.threads; ++id)
+  {
+    threads.emplace_back(worker<T>, cref(options), id, ref(perThread[id]));
+  }
+  for (auto &t : threads)
+  {
+    t.join();
+  }
+  double elapsed = chrono::duration<double>(Clock::now() - start).count();
+
+  printf("%-10s %10s %12s %12s %12s %12s\n", "operation", "count", "ops/s", "p50 us", "p99 us", "p999 us");
+  for (int op = 0; op < OPERATION_COUNT; ++op)
+  {
+    vector<double> all;
+    for (const auto &latencies : perThread)
+    {
+      all.insert(all.end(), latencies[size_t(op)].begin(), latencies[size_t(op)].end());
+    }
+    if (all.empty())
+    {
+      continue;
+    }
+    sort(all.begin(), all.end());
+    printf("%-10s %10zu %12.1f %12.3f %12.3f %12.3f\n", OPERATION_NAMES[op], all.size(), double(all.size()) / elapsed,
+           percentile(all, 0.5) / 1000, percentile(all, 0.99) / 1000, percentile(all, 0.999) / 1000);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  try
+  {
+    Options options = parseOptions(argc, argv);
+    printf("# size=%zu threads=%u duration=%.1fs type=%s\n", options.size, options.threads, options.duration, options.type.c_str());
+    if (options.type == "int")
+    {
+      run<int>(options);
+    }
+    else if (options.type == "string")
+    {
+      run<string>(options);
+    }
+    else
+    {
+      throw invalid_argument("unknown type: " + options.type);
+    }
+  }
+  catch (const exception &e)
+  {
+    fprintf(stderr, "loadgen: %s\n", e.what());
+    return 1;
+  }
+}
@@ -0,0 +1,282 @@
+/**
+ * Tests for the queries answered over a tree: LcaIndex answers are checked against
+ * paths walked with ancestors() on generated trees with distinct values, so every
+ * value names one node; range_aggregate and RangeTable are checked against a linear
+ * scan of the inorder values. Lookups through key_equal/key_hash compare only the
+ * projected key.
+ */
+
+#include "doctest.h"
+#include "BinaryTree.hpp"
+#include "LcaIndex.hpp"
+#include "RangeTable.hpp"
+#include "TreeGenerator.hpp"
+#include "KeyPolicy.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+using namespace ariel;
+
+namespace
+{
+    using Tree = BinaryTree<int>;
+
+    template <typename AnyTree>
+    std::vector<int> inorder(AnyTree &tree)
+    {
+        std::vector<int> values;
+        for (auto it = tree.begin_inorder(); it != tree.end_inorder(); ++it)
+        {
+            values.push_back(*it);
+        }
+        return values;
+    }
+
+    // a polynomial hash of the sequence, so combining out of order gives a different value
+    struct OrderedAggregate
+    {
+        struct value_type
+        {
+            std::uint64_t scale;
+            std::uint64_t hash;
+        };
+        static value_type identity() { return {1, 0}; }
+        static value_type lift(int value) { return {31, static_cast<std::uint64_t>(value) + 1}; }
+        static value_type combine(const value_type &a, const value_type &b) { return {a.scale * b.scale, a.hash * b.scale + b.hash}; }
+    };
+
+    struct Record
+    {
+        int id;
+        std::string payload;
+    };
+
+    struct RecordId
+    {
+        const int &operator()(const Record &r) const { return r.id; }
+    };
+
+    using RecordTree = BinaryTree<Record, NoCounters, key_equal<RecordId>, key_hash<RecordId>>;
+
+    std::vector<std::string> payloads(RecordTree &tree)
+    {
+        std::vector<std::string> out;
+        for (auto it = tree.begin_preorder(); it != tree.end_preorder(); ++it)
+        {
+            out.push_back(std::to_string(it->id) + it->payload);
+        }
+        return out;
+    }
+
+    // the values from the node up to the root
+    std::vector<int> path(const Tree &tree, Tree::node_handle node)
+    {
+        static_assert(std::is_same_v<decltype(*tree.ancestors(node).begin()), const int &>,
+                      "ancestors() of a const tree must not hand out writable values");
+        std::vector<int> values;
+        for (int value : tree.ancestors(node))
+        {
+            values.push_back(value);
+        }
+        return values;
+    }
+}
+
+TEST_CASE("LcaIndex and depth() agree with the ancestor paths on random trees")
+{
+    for (std::uint64_t seed = 1; seed <= 10; ++seed)
+    {
+        CAPTURE(seed);
+        Tree tree = TreeGenerator<int>(seed).values(Values::SHUFFLED).build(Shape::RANDOM_SPLIT, 200);
+        LcaIndex<Tree> index(tree);
+        REQUIRE(index.size() == 200);
+
+        for (std::uint32_t a = 0; a < 200; a += 7)
+        {
+            std::vector<int> up = path(tree, index.node(a));
+            std::size_t depth = up.size() - 1;
+            CHECK(index.depth(a) == depth);
+            CHECK(tree.depth(index.node(a)) == depth);
+            for (std::size_t d = 0; d <= depth; ++d)
+            {
+                CHECK(tree.value(index.node(index.level_ancestor(a, d))) == up[depth - d]);
+            }
+
+            for (std::uint32_t b = 0; b < 200; b += 13)
+            {
+                std::vector<int> other = path(tree, index.node(b));
+                // walk both paths down from the root while they agree
+                std::size_t common = 0;
+                while (common < up.size() && common < other.size() &&
+                       up[up.size() - 1 - common] == other[other.size() - 1 - common])
+                {
+                    ++common;
+                }
+                int expected = up[up.size() - common];
+                CHECK(tree.value(index.node(index.lca(a, b))) == expected);
+                CHECK(tree.value(index.lca(index.node(a), index.node(b))) == expected);
+                CHECK(index.distance(a, b) == up.size() + other.size() - 2 * common);
+            }
+        }
+    }
+}
+
+TEST_CASE("Batch lca gives the single-query answers")
+{
+    for (std::uint64_t seed = 1; seed <= 5; ++seed)
+    {
+        CAPTURE(seed);
+        Tree tree = TreeGenerator<int>(seed).values(Values::SHUFFLED).build(Shape::RANDOM_SPLIT, 200);
+        LcaIndex<Tree> index(tree);
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> numbers;
+        std::vector<std::pair<Tree::node_handle, Tree::node_handle>> handles;
+        for (std::uint32_t a = 0; a < 200; a += 7)
+        {
+            for (std::uint32_t b = 0; b < 200; b += 13)
+            {
+                numbers.emplace_back(a, b);
+                handles.emplace_back(index.node(a), index.node(b));
+            }
+        }
+        std::vector<std::uint32_t> byNumber = index.lca(numbers);
+        std::vector<Tree::node_handle> byHandle = index.lca(handles);
+        REQUIRE(byNumber.size() == numbers.size());
+        REQUIRE(byHandle.size() == handles.size());
+        for (std::size_t i = 0; i < numbers.size(); ++i)
+        {
+            CHECK(byNumber[i] == index.lca(numbers[i].first, numbers[i].second));
+            CHECK(byHandle[i] == index.lca(handles[i].first, handles[i].second));
+            CHECK(byHandle[i] == index.node(byNumber[i]));
+        }
+        CHECK(index.lca(std::vector<std::pair<std::uint32_t, std::uint32_t>>{}).empty());
+        CHECK_THROWS_AS(index.lca(std::vector<std::pair<std::uint32_t, std::uint32_t>>{{0, 1}, {0, 200}}), std::invalid_argument);
+    }
+}
+
+TEST_CASE("LcaIndex rejects numbers outside the index")
+{
+    Tree tree = TreeGenerator<int>().build(Shape::COMPLETE, 10);
+    LcaIndex<Tree> index(tree);
+    CHECK_THROWS_AS(index.lca(0, 10), std::invalid_argument);
+    CHECK_THROWS_AS(index.distance(10, 0), std::invalid_argument);
+    CHECK_THROWS_AS(index.distance(0, 10), std::invalid_argument);
+    CHECK_THROWS_AS(index.level_ancestor(10, 0), std::invalid_argument);
+    CHECK_THROWS_AS(index.level_ancestor(9, 4), std::invalid_argument);
+}
+
+TEST_CASE("range_aggregate and RangeTable agree with a linear scan")
+{
+    for (std::uint64_t seed = 1; seed <= 5; ++seed)
+    {
+        CAPTURE(seed);
+        Tree source = TreeGenerator<int>(seed).values(Values::SHUFFLED).build(Shape::RANDOM_SPLIT, 90);
+        std::vector<int> pre;
+        for (auto it = source.begin_preorder(); it != source.end_preorder(); ++it)
+        {
+            pre.push_back(*it);
+        }
+        using SumTree = AggregateTree<int, SizedAggregate<SumAggregate<int>>>;
+        using MinTree = AggregateTree<int, SizedAggregate<MinAggregate<int>>>;
+        using OrderedTree = AggregateTree<int, SizedAggregate<OrderedAggregate>>;
+        SumTree sums = SumTree::from_preorder_inorder(pre, inorder(source));
+        MinTree mins = MinTree::from_preorder_inorder(pre, inorder(source));
+        OrderedTree ordered = OrderedTree::from_preorder_inorder(pre, inorder(source));
+
+        // replace refreshes the aggregates along the path, and leaves repeated values behind
+        for (int value = 0; value < 90; value += 11)
+        {
+            sums.replace(sums.find(value), value % 7);
+            mins.replace(mins.find(value), value % 7);
+            ordered.replace(ordered.find(value), value % 7);
+        }
+        std::vector<int> values = inorder(sums);
+        REQUIRE(inorder(mins) == values);
+        RangeTable<SumAggregate<int>> sumTable(sums);
+        RangeTable<MinAggregate<int>> minTable(mins);
+        RangeTable<OrderedAggregate> orderedTable(ordered);
+
+        for (std::size_t first = 0; first < values.size(); first += 3)
+        {
+            for (std::size_t last = first; last < values.size(); last += 5)
+            {
+                CAPTURE(first);
+                CAPTURE(last);
+                int sum = 0;
+                int min = values[first];
+                OrderedAggregate::value_type hash = OrderedAggregate::identity();
+                for (std::size_t i = first; i <= last; ++i)
+                {
+                    sum += values[i];
+                    min = std::min(min, values[i]);
+                    hash = OrderedAggregate::combine(hash, OrderedAggregate::lift(values[i]));
+                }
+                CHECK(sums.range_aggregate(first, last) == sum);
+                CHECK(sumTable.query(first, last) == sum);
+                CHECK(mins.range_aggregate(first, last) == min);
+                CHECK(minTable.query(first, last) == min);
+                CHECK(ordered.range_aggregate(first, last).hash == hash.hash);
+                CHECK(orderedTable.query(first, last).hash == hash.hash);
+            }
+        }
+    }
+}
+
+TEST_CASE("Range queries reject positions outside the tree")
+{
+    using SumTree = AggregateTree<int, SizedAggregate<SumAggregate<int>>>;
+    SumTree tree;
+    tree.add_root(1).add_left(1, 2).add_right(1, 3);
+    RangeTable<SumAggregate<int>> table(tree);
+    CHECK(tree.range_aggregate(0, 2) == 6);
+    CHECK(table.query(0, 2) == 6);
+    CHECK_THROWS_AS(tree.range_aggregate(0, 3), std::invalid_argument);
+    CHECK_THROWS_AS(tree.range_aggregate(2, 1), std::invalid_argument);
+    CHECK_THROWS_AS(table.query(0, 3), std::invalid_argument);
+    CHECK_THROWS_AS(table.query(2, 1), std::invalid_argument);
+}
+
+TEST_CASE("A projected-key tree looks values up by their key alone")
+{
+    RecordTree tree;
+    tree.add_root({1, "a"}).add_left(1, {2, "b"}).add_right(Record{1, "ignored"}, {3, "c"});
+    CHECK(payloads(tree) == std::vector<std::string>{"1a", "2b", "3c"});
+
+    SUBCASE("find and contains")
+    {
+        CHECK(tree.find(3)->payload == "c");
+        CHECK(tree.find(Record{2, "other"})->payload == "b");
+        CHECK(tree.contains(1));
+        CHECK(tree.contains(Record{3, ""}));
+        CHECK_FALSE(tree.contains(4));
+        CHECK(tree.find(4) == tree.end());
+    }
+    SUBCASE("add_left and add_right by key")
+    {
+        tree.add_left(3, {4, "d"}).add_right(2, {5, "e"});
+        tree.add_left(1, {2, "renamed"}); // the same key, a new payload, in place
+        CHECK(payloads(tree) == std::vector<std::string>{"1a", "2renamed", "5e", "3c", "4d"});
+        CHECK_THROWS_AS(tree.add_left(9, {10, "x"}), std::invalid_argument);
+    }
+    SUBCASE("add_edges")
+    {
+        using edge = RecordTree::edge;
+        tree.add_edges(std::vector<edge>{{{4, ""}, {6, "f"}, Side::LEFT}, {{3, "any"}, {4, "d"}, Side::RIGHT}, {{2, ""}, {5, "e"}, Side::LEFT}});
+        CHECK(payloads(tree) == std::vector<std::string>{"1a", "2b", "5e", "3c", "4d", "6f"});
+    }
+    SUBCASE("equal keys hash equally")
+    {
+        key_hash<RecordId> hash;
+        key_equal<RecordId> equal;
+        CHECK(equal(Record{7, "x"}, Record{7, "y"}));
+        CHECK(equal(Record{7, "x"}, 7));
+        CHECK_FALSE(equal(Record{7, "x"}, Record{8, "x"}));
+        CHECK(hash(Record{7, "x"}) == hash(Record{7, "y"}));
+        CHECK(hash(Record{7, "x"}) == hash(7));
+        CHECK(hash(7) == std::hash<int>()(7));
+    }
+}
@@ -2,25 +2,164 @@
 #include "doctest.h"
 using namespace doctest;
 
-const int MIN_TESTS = 20;
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
 
+const int MIN_TESTS = 20;
+const double DEFAULT_BUDGET_MS = 1000;
 
+/*
+ * Besides the console output, records the duration of every test case and subcase,
+ * flags the ones over a latency budget and writes everything to a JSON report.
+ *
+ * TEST_BUDGET_MS sets the budget in milliseconds (default 1000).
+ * TEST_REPORT sets the report path (default <binary>_report.json).
+ */
 struct ReporterGrader: public ConsoleReporter {
+    using Clock = std::chrono::steady_clock;
+
+    struct Timing {
+        std::string name;
+        double ms;
+        int runs;
+        bool passed;
+    };
+
+    struct OpenSubcase {
+        std::string path;
+        Clock::time_point start;
+        bool passed;
+    };
+
+    double budgetMs = DEFAULT_BUDGET_MS;
+    std::string reportPath;
+    std::vector<Timing> testCases;
+    std::vector<Timing> subcases;
+    Clock::time_point testCaseStart;
+    std::vector<OpenSubcase> openSubcases;
+
     ReporterGrader(const ContextOptions& input_options)
-            : ConsoleReporter(input_options) {}
+            : ConsoleReporter(input_options) {
+        if (const char* budget = std::getenv("TEST_BUDGET_MS")) {
+            budgetMs = std::strtod(budget, nullptr);
+        }
+        if (const char* path = std::getenv("TEST_REPORT")) {
+            reportPath = path;
+        } else {
+            std::string binary = input_options.binary_name.c_str();
+            reportPath = (binary.empty() ? std::string("test") : binary) + "_report.json";
+        }
+    }
+
+    static double elapsedMs(Clock::time_point since) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    }
+
+    static std::string escape(const std::string& text) {
+        std::string out;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                out += ' ';
+            } else {
+                out += c;
+            }
+        }
+        return out;
+    }
+
+    void writeTimings(std::ofstream& out, const char* key, const std::vector<Timing>& timings) const {
+        out << "  \"" << key << "\": [";
+        for (size_t i = 0; i < timings.size(); ++i) {
+            const Timing& t = timings[i];
+            out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << escape(t.name) << "\", \"ms\": " << t.ms
+                << ", \"runs\": " << t.runs << ", \"passed\": " << (t.passed ? "true" : "false")
+                << ", \"over_budget\": " << (t.ms > budgetMs ? "true" : "false") << "}";
+        }
+        out << (timings.empty() ? "]" : "\n  ]");
+    }
+
+    void test_case_start(const TestCaseData& in) override {
+        ConsoleReporter::test_case_start(in);
+        testCaseStart = Clock::now();
+    }
+
+    void test_case_end(const CurrentTestCaseStats& st) override {
+        ConsoleReporter::test_case_end(st);
+        double ms = elapsedMs(testCaseStart);
+        testCases.push_back({tc->m_name, ms, 1, st.failure_flags == 0});
+        if (ms > budgetMs) {
+            s << Color::Yellow << "[budget] " << Color::None << tc->m_name << " took " << ms
+              << " ms (budget " << budgetMs << " ms)\n";
+        }
+    }
+
+    void subcase_start(const SubcaseSignature& in) override {
+        ConsoleReporter::subcase_start(in);
+        std::string path = openSubcases.empty() ? std::string(tc->m_name) : openSubcases.back().path;
+        openSubcases.push_back({path + " / " + in.m_name.c_str(), Clock::now(), true});
+    }
+
+    void subcase_end() override {
+        ConsoleReporter::subcase_end();
+        if (openSubcases.empty()) {
+            return;
+        }
+        const OpenSubcase& open = openSubcases.back();
+        double ms = elapsedMs(open.start);
+        bool found = false;
+        for (Timing& t : subcases) {
+            if (t.name == open.path) {
+                t.ms += ms;
+                ++t.runs;
+                t.passed = t.passed && open.passed;
+                found = true;
+            }
+        }
+        if (!found) {
+            subcases.push_back({open.path, ms, 1, open.passed});
+        }
+        openSubcases.pop_back();
+    }
+
+    void log_assert(const AssertData& rb) override {
+        ConsoleReporter::log_assert(rb);
+        if (rb.m_failed) {
+            for (OpenSubcase& open : openSubcases) {
+                open.passed = false;
+            }
+        }
+    }
 
     void test_run_end(const TestRunStats& run_stats) override {
         ConsoleReporter::test_run_end(run_stats);
         int numAsserts = run_stats.numAsserts >=  MIN_TESTS? run_stats.numAsserts:  MIN_TESTS;
         float grade = (run_stats.numAsserts - run_stats.numAssertsFailed) * 100 / numAsserts;
         // std::cout << "Grade: " << grade << std::endl;
+
+        std::ofstream out(reportPath);
+        if (!out) {
+            s << Color::Red << "[report] cannot write " << reportPath << Color::None << "\n";
+            return;
+        }
+        out << "{\n  \"grade\": " << grade << ",\n  \"asserts\": " << run_stats.numAsserts
+            << ",\n  \"asserts_failed\": " << run_stats.numAssertsFailed << ",\n  \"budget_ms\": " << budgetMs << ",\n";
+        writeTimings(out, "test_cases", testCases);
+        out << ",\n";
+        writeTimings(out, "subcases", subcases);
+        out << "\n}\n";
     }
 };
 
 REGISTER_REPORTER("grader", /*priority=*/1, ReporterGrader);
 
 int main(int argc, char** argv) {
-    Context context;
+    Context context(argc, argv);
     context.addFilter("reporters", "grader");
     return context.run();
 }
@@ -0,0 +1,234 @@
+/**
+ * Tests for the walks that do not use the parent-pointer iterators: the explicit-stack
+ * walk<W> ranges, and the for_each_* visitors with their Visit control codes. Every
+ * sequence is compared element by element with the matching begin_* iterator (level
+ * order with a breadth-first walk of the nodes) on generated trees with distinct values.
+ */
+
+#include "doctest.h"
+#include "BinaryTree.hpp"
+#include "TreeGenerator.hpp"
+
+#include <cstddef>
+#include <queue>
+#include <utility>
+#include <vector>
+using namespace ariel;
+
+namespace
+{
+    using Tree = BinaryTree<int>;
+
+    std::vector<int> walk(Tree::iterator it, Tree::iterator end)
+    {
+        std::vector<int> values;
+        for (; it != end; ++it)
+        {
+            values.push_back(*it);
+        }
+        return values;
+    }
+
+    std::vector<int> preorder(Tree &tree)
+    {
+        return walk(tree.begin_preorder(), tree.end_preorder());
+    }
+
+    std::vector<int> inorder(Tree &tree)
+    {
+        return walk(tree.begin_inorder(), tree.end_inorder());
+    }
+
+    std::vector<int> postorder(Tree &tree)
+    {
+        return walk(tree.begin_postorder(), tree.end_postorder());
+    }
+
+    template <Walk W>
+    std::vector<int> stack_walk(Tree &tree)
+    {
+        std::vector<int> values;
+        for (int value : tree.walk<W>())
+        {
+            values.push_back(value);
+        }
+        return values;
+    }
+
+    std::vector<int> level_order(Tree &tree)
+    {
+        std::vector<int> values;
+        std::queue<const Tree::node_type *> pending;
+        if (tree.begin_preorder() != tree.end_preorder())
+        {
+            pending.push(&tree.begin_preorder().Node());
+        }
+        for (; !pending.empty(); pending.pop())
+        {
+            const Tree::node_type *node = pending.front();
+            values.push_back(node->_value);
+            for (const Tree::node_type *child : {node->_left, node->_right})
+            {
+                if (child != nullptr)
+                {
+                    pending.push(child);
+                }
+            }
+        }
+        return values;
+    }
+
+    // the sequence without the values of the subtree below value's child on one side
+    std::vector<int> without_child(Tree &tree, const std::vector<int> &sequence, int value, bool left)
+    {
+        const Tree::node_type &node = tree.find(value).Node();
+        const Tree::node_type *child = left ? node._left : node._right;
+        if (child == nullptr)
+        {
+            return sequence;
+        }
+        std::vector<int> removed = walk(tree.begin_preorder(tree.find(child->_value)), tree.end_preorder());
+        std::vector<int> kept;
+        for (int v : sequence)
+        {
+            bool skipped = false;
+            for (int r : removed)
+            {
+                skipped = skipped || r == v;
+            }
+            if (!skipped)
+            {
+                kept.push_back(v);
+            }
+        }
+        return kept;
+    }
+
+    const Shape SHAPES[] = {Shape::COMPLETE, Shape::PERFECT, Shape::LEFT_CHAIN, Shape::RIGHT_CHAIN,
+                            Shape::RANDOM_SPLIT, Shape::FIBONACCI, Shape::CATERPILLAR};
+}
+
+TEST_CASE("walk<W> visits in the order of the matching iterator")
+{
+    for (Shape shape : SHAPES)
+    {
+        // 300 nodes make the chains deeper than the 64 inline levels of the stack
+        for (std::size_t n : {0U, 1U, 2U, 7U, 88U, 300U})
+        {
+            if (shape == Shape::FIBONACCI && n == 300)
+            {
+                continue; // not a Fibonacci tree size
+            }
+            CAPTURE(int(shape));
+            CAPTURE(n);
+            Tree tree = TreeGenerator<int>(n).values(Values::SHUFFLED).build(shape, n);
+            CHECK(stack_walk<Walk::PREORDER>(tree) == preorder(tree));
+            CHECK(stack_walk<Walk::INORDER>(tree) == inorder(tree));
+            CHECK(stack_walk<Walk::POSTORDER>(tree) == postorder(tree));
+            CHECK(stack_walk<Walk::LEVEL_ORDER>(tree) == level_order(tree));
+        }
+    }
+}
+
+TEST_CASE("for_each_* visit in the order of the matching iterator")
+{
+    for (Shape shape : SHAPES)
+    {
+        for (std::size_t n : {0U, 1U, 2U, 7U, 88U, 200U})
+        {
+            if (shape == Shape::FIBONACCI && n == 200)
+            {
+                continue; // not a Fibonacci tree size
+            }
+            CAPTURE(int(shape));
+            CAPTURE(n);
+            Tree tree = TreeGenerator<int>(n).values(Values::SHUFFLED).build(shape, n);
+            std::vector<int> pre;
+            std::vector<int> in;
+            std::vector<int> post;
+            tree.for_each_preorder([&pre](int value) { pre.push_back(value); });
+            tree.for_each_inorder([&in](int value) { in.push_back(value); });
+            tree.for_each_postorder([&post](int value) { post.push_back(value); });
+            CHECK(pre == preorder(tree));
+            CHECK(in == inorder(tree));
+            CHECK(post == postorder(tree));
+        }
+    }
+}
+
+TEST_CASE("Visit::SKIP prunes exactly one subtree")
+{
+    for (Shape shape : SHAPES)
+    {
+        CAPTURE(int(shape));
+        Tree tree = TreeGenerator<int>(3).values(Values::SHUFFLED).build(shape, shape == Shape::FIBONACCI ? 88 : 100);
+        std::vector<int> pre = preorder(tree);
+        std::vector<int> in = inorder(tree);
+        for (std::size_t i = 0; i < pre.size(); i += 9)
+        {
+            int at = pre[i];
+            CAPTURE(at);
+            std::vector<int> visited;
+            tree.for_each_preorder([&](int value) {
+                visited.push_back(value);
+                return value == at ? Visit::SKIP : Visit::CONTINUE;
+            });
+            // both children go, the node itself stays
+            CHECK(visited == without_child(tree, without_child(tree, pre, at, true), at, false));
+
+            visited.clear();
+            tree.for_each_inorder([&](int value) {
+                visited.push_back(value);
+                return value == at ? Visit::SKIP : Visit::CONTINUE;
+            });
+            CHECK(visited == without_child(tree, in, at, false));
+
+            visited.clear();
+            tree.for_each_postorder([&](int value) {
+                visited.push_back(value);
+                return value == at ? Visit::SKIP : Visit::CONTINUE;
+            });
+            CHECK(visited == postorder(tree));
+        }
+    }
+}
+
+TEST_CASE("Visit::STOP ends the walk at the node that returns it")
+{
+    Tree tree = TreeGenerator<int>(5).values(Values::SHUFFLED).build(Shape::RANDOM_SPLIT, 60);
+    auto check = [](const std::vector<int> &expected, auto run) {
+        for (std::size_t stop = 0; stop < expected.size(); stop += 4)
+        {
+            CAPTURE(stop);
+            std::vector<int> visited;
+            run([&](int value) {
+                visited.push_back(value);
+                return value == expected[stop] ? Visit::STOP : Visit::CONTINUE;
+            });
+            CHECK(visited == std::vector<int>(expected.begin(), expected.begin() + long(stop) + 1));
+        }
+    };
+    check(preorder(tree), [&tree](auto f) { tree.for_each_preorder(f); });
+    check(inorder(tree), [&tree](auto f) { tree.for_each_inorder(f); });
+    check(postorder(tree), [&tree](auto f) { tree.for_each_postorder(f); });
+}
+
+TEST_CASE("Visit::STOP inside the left subtree ends a postorder walk")
+{
+    //        1
+    //     2     3
+    //   4   5     6
+    Tree tree;
+    tree.add_root(1).add_left(1, 2).add_right(1, 3).add_left(2, 4).add_right(2, 5).add_right(3, 6);
+    const std::pair<int, std::vector<int>> cases[] = {{4, {4}}, {5, {4, 5}}, {2, {4, 5, 2}}};
+    for (const auto &[stop, expected] : cases)
+    {
+        CAPTURE(stop);
+        std::vector<int> visited;
+        tree.for_each_postorder([&, stop = stop](int value) {
+            visited.push_back(value);
+            return value == stop ? Visit::STOP : Visit::CONTINUE;
+        });
+        CHECK(visited == expected);
+    }
+}
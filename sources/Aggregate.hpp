@@ -0,0 +1,139 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+namespace ariel
+{
+    /*
+     * Aggregate policies: a monoid over node values that BinaryTree keeps per node for
+     * the whole subtree below it. A policy provides
+     *
+     *     using value_type = ...;
+     *     static value_type identity();
+     *     static value_type lift(const T &value);
+     *     static value_type combine(const value_type &a, const value_type &b);
+     *
+     * combine must be associative with identity as its neutral element. A subtree
+     * aggregates as combine(combine(left, lift(value)), right), i.e. in inorder, so
+     * non-commutative monoids see the values in inorder too.
+     *
+     * NoAggregate stores nothing and compiles every update away.
+     */
+    struct NoAggregate
+    {
+    };
+
+    template <typename V>
+    struct SumAggregate
+    {
+        using value_type = V;
+        static value_type identity() { return V(); }
+        static value_type lift(const V &value) { return value; }
+        static value_type combine(const value_type &a, const value_type &b) { return a + b; }
+    };
+
+    template <typename V>
+    struct MinAggregate
+    {
+        using value_type = V;
+        static value_type identity() { return std::numeric_limits<V>::max(); }
+        static value_type lift(const V &value) { return value; }
+        static value_type combine(const value_type &a, const value_type &b) { return std::min(a, b); }
+    };
+
+    template <typename V>
+    struct MaxAggregate
+    {
+        using value_type = V;
+        static value_type identity() { return std::numeric_limits<V>::lowest(); }
+        static value_type lift(const V &value) { return value; }
+        static value_type combine(const value_type &a, const value_type &b) { return std::max(a, b); }
+    };
+
+    struct CountAggregate
+    {
+        using value_type = std::size_t;
+        static value_type identity() { return 0; }
+        template <typename T>
+        static value_type lift(const T & /*value*/) { return 1; }
+        static value_type combine(const value_type &a, const value_type &b) { return a + b; }
+    };
+
+    /*
+     * Pairs an aggregate with the subtree size, which lets BinaryTree::range_aggregate
+     * locate inorder positions. value_type holds both; inner is the wrapped policy.
+     */
+    template <typename Aggregate>
+    struct SizedAggregate
+    {
+        using inner = Aggregate;
+        struct value_type
+        {
+            std::size_t size;
+            typename Aggregate::value_type value;
+        };
+        static value_type identity() { return {0, Aggregate::identity()}; }
+        template <typename T>
+        static value_type lift(const T &value) { return {1, Aggregate::lift(value)}; }
+        static value_type combine(const value_type &a, const value_type &b) { return {a.size + b.size, Aggregate::combine(a.value, b.value)}; }
+    };
+
+    template <typename Aggregate>
+    struct is_sized_aggregate : std::false_type
+    {
+    };
+
+    template <typename Aggregate>
+    struct is_sized_aggregate<SizedAggregate<Aggregate>> : std::true_type
+    {
+    };
+
+    /*
+     * Structural (Merkle) hash of a subtree: it covers the node's value, both child
+     * hashes and which children exist, so equal hashes mean equal trees with high
+     * probability. This is not a monoid: combine is deliberately order-sensitive and
+     * non-associative, and identity is only the marker of an absent child. Use it
+     * for tree equality and diff, not with range_aggregate. Hasher must agree with the
+     * tree's KeyEqual: values the tree considers equal must hash equally.
+     */
+    template <typename T, typename Hasher = std::hash<T>>
+    struct MerkleAggregate
+    {
+        using value_type = std::size_t;
+        static value_type identity() { return 0x6a09e667f3bcc909ULL; }
+        static value_type lift(const T &value) { return Hasher()(value); }
+        static value_type combine(const value_type &a, const value_type &b)
+        {
+            std::size_t mixed = (a ^ 0x9e3779b97f4a7c15ULL) * 0xbf58476d1ce4e5b9ULL;
+            mixed = (mixed ^ (mixed >> 31U)) + b;
+            return (mixed ^ (mixed >> 29U)) * 0x94d049bb133111ebULL;
+        }
+    };
+
+    template <typename Aggregate>
+    struct is_merkle_aggregate : std::false_type
+    {
+    };
+
+    template <typename T, typename Hasher>
+    struct is_merkle_aggregate<MerkleAggregate<T, Hasher>> : std::true_type
+    {
+    };
+
+    /*
+     * Per-node storage for an aggregate; Node derives from it, so NoAggregate costs no space.
+     */
+    template <typename Aggregate>
+    struct AggregateSlot
+    {
+        typename Aggregate::value_type _aggregate = Aggregate::identity();
+    };
+
+    template <>
+    struct AggregateSlot<NoAggregate>
+    {
+    };
+}
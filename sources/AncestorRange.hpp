@@ -0,0 +1,74 @@
+#pragma once
+#include "Node.hpp"
+
+namespace ariel
+{
+    /*
+     * Follows _parent pointers from a node to the root, visiting the node itself first.
+     * The values are read-only: the tree hands these out from const members, and a
+     * write through them would also skip the refresh of the aggregates above.
+     */
+    template <typename T, typename Aggregate = NoAggregate>
+    class ancestor_iterator
+    {
+    private:
+        const Node<T, Aggregate> *_current = nullptr;
+
+    public:
+        ancestor_iterator() = default;
+        explicit ancestor_iterator(const Node<T, Aggregate> *node) : _current(node) {}
+
+        const T &operator*() const
+        {
+            return this->_current->_value;
+        }
+
+        const T *operator->() const
+        {
+            return &(this->_current->_value);
+        }
+
+        bool operator==(const ancestor_iterator &rhs) const
+        {
+            return this->_current == rhs._current;
+        }
+
+        bool operator!=(const ancestor_iterator &rhs) const
+        {
+            return this->_current != rhs._current;
+        }
+
+        ancestor_iterator &operator++()
+        {
+            this->_current = this->_current->_parent;
+            return *this;
+        }
+
+        ancestor_iterator operator++(int)
+        {
+            ancestor_iterator temp = *this;
+            this->operator++();
+            return temp;
+        }
+    };
+
+    template <typename T, typename Aggregate = NoAggregate>
+    class ancestor_range
+    {
+    private:
+        const Node<T, Aggregate> *_node;
+
+    public:
+        explicit ancestor_range(const Node<T, Aggregate> *node) : _node(node) {}
+
+        ancestor_iterator<T, Aggregate> begin() const
+        {
+            return ancestor_iterator<T, Aggregate>(this->_node);
+        }
+
+        ancestor_iterator<T, Aggregate> end() const
+        {
+            return ancestor_iterator<T, Aggregate>();
+        }
+    };
+}
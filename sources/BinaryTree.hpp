@@ -1,236 +1,1332 @@
 #pragma once
 #include "Node.hpp"
+#include "Counters.hpp"
+#include "KeyPolicy.hpp"
+#include "Prefetch.hpp"
+#include "StackIterator.hpp"
+#include "AncestorRange.hpp"
 #include <stdexcept>
 #include <iostream>
 #include <cmath>
 #include <string>
 #include <vector>
 #include <queue>
+#include <deque>
+#include <memory>
+#include <iterator>
+#include <unordered_set>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <utility>
 
 namespace ariel
 {
-    template <typename T>
+    template <typename T, typename Tree>
+    class TreeGenerator;
+
+    template <typename Tree>
+    class LcaIndex;
+
+    enum class Side
+    {
+        LEFT,
+        RIGHT
+    };
+
+    /*
+     * What a for_each_* callback asks for next. A callback returning void always continues.
+     */
+    enum class Visit
+    {
+        CONTINUE,
+        SKIP, // do not descend into the rest of this node's subtree
+        STOP
+    };
+
+    /*
+     * Counters selects the operation-counting policy (see Counters.hpp); the default
+     * NoCounters compiles every hook away.
+     * KeyEqual decides whether a node matches a lookup key, and Hash must agree with it;
+     * every value index built by the tree uses both. Use key_equal/key_hash
+     * (KeyPolicy.hpp) to match on one field of a heavy value.
+     * Aggregate keeps a monoid of every subtree's values in its root node (see
+     * Aggregate.hpp and aggregate()); the default NoAggregate stores nothing.
+     */
+    template <typename T, typename Counters = NoCounters, typename KeyEqual = std::equal_to<>, typename Hash = std::hash<T>, typename Aggregate = NoAggregate>
     class BinaryTree
     {
+    public:
+        using value_type = T;
+        using node_type = Node<T, Aggregate>;
+        class iterator;
+        class node_handle;
+        struct difference;
+
     private:
-        Node<T> *_root = nullptr;
+        Node<T, Aggregate> *_root = nullptr;
+        Node<T, Aggregate> *_free = nullptr; // released nodes, linked through _right, reused before allocating
+
+        /*
+         * Bulk-allocated nodes. An arena is shared by every tree that holds some of its
+         * nodes (after extract_subtree or graft), and freed with the last of them.
+         */
+        using Arena = std::vector<Node<T, Aggregate>>;
+        std::vector<std::shared_ptr<Arena>> _arenas;
+
+        template <typename, typename>
+        friend class TreeGenerator;
+
+        Node<T, Aggregate> *new_node(const T &val)
+        {
+            if (this->_free == nullptr)
+            {
+                Counters::on_alloc();
+                return new Node<T, Aggregate>(val);
+            }
+            Node<T, Aggregate> *node = this->_free;
+            this->_free = node->_right;
+            node->_value = val;
+            node->_right = nullptr;
+            return node;
+        }
+
+        // counted as one allocation, freed when the last tree sharing it drops it
+        Arena &reserve_arena(std::size_t n)
+        {
+            std::shared_ptr<Arena> arena(new Arena(), [](Arena *dropped) {
+                delete dropped;
+                Counters::on_free();
+            });
+            arena->reserve(n);
+            Counters::on_alloc();
+            this->_arenas.push_back(arena);
+            return *arena;
+        }
+
+        /*
+         * The arena must have been reserved large enough: growing it would move its nodes.
+         */
+        static Node<T, Aggregate> *arena_node(Arena &arena, const T &val)
+        {
+            arena.emplace_back(val);
+            Node<T, Aggregate> *node = &arena.back();
+            node->_arena = true;
+            return node;
+        }
+
+        void share_arenas(const BinaryTree &tree)
+        {
+            for (const auto &arena : tree._arenas)
+            {
+                if (std::find(this->_arenas.begin(), this->_arenas.end(), arena) == this->_arenas.end())
+                {
+                    this->_arenas.push_back(arena);
+                }
+            }
+        }
+
+        /*
+         * Returns a detached node to the free list. Its memory stays owned by the tree
+         * until destruction, so stale handles can still read the bumped generation.
+         */
+        void release_node(Node<T, Aggregate> *node)
+        {
+            ++node->_generation;
+            node->_left = nullptr;
+            node->_parent = nullptr;
+            node->_right = this->_free;
+            this->_free = node;
+        }
+
+        static auto aggregate_of(const Node<T, Aggregate> *node)
+        {
+            return node == nullptr ? Aggregate::identity() : node->_aggregate;
+        }
+
+        /*
+         * Recomputes the aggregates from node up to the root, after node's value or
+         * children changed: O(depth).
+         */
+        static void refresh_path(Node<T, Aggregate> *node)
+        {
+            if constexpr (!std::is_same_v<Aggregate, NoAggregate>)
+            {
+                for (; node != nullptr; node = node->_parent)
+                {
+                    node->_aggregate = Aggregate::combine(Aggregate::combine(aggregate_of(node->_left), Aggregate::lift(node->_value)),
+                                                          aggregate_of(node->_right));
+                }
+            }
+        }
+
+        // recomputes every aggregate, children before parents, after a bulk build
+        void refresh_all()
+        {
+            if constexpr (!std::is_same_v<Aggregate, NoAggregate>)
+            {
+                for (auto it = this->begin_postorder(); it != this->end_postorder(); ++it)
+                {
+                    Node<T, Aggregate> *node = at(it);
+                    node->_aggregate = Aggregate::combine(Aggregate::combine(aggregate_of(node->_left), Aggregate::lift(node->_value)),
+                                                          aggregate_of(node->_right));
+                }
+            }
+        }
+
+        /*
+         * Detaches the subtree rooted at top and releases its nodes, children first,
+         * walking the parent pointers instead of recursing or buffering.
+         * Returns the number of nodes released.
+         */
+        std::size_t release_subtree(Node<T, Aggregate> *top)
+        {
+            Node<T, Aggregate> *above = top->_parent;
+            if (top == this->_root)
+            {
+                this->_root = nullptr;
+            }
+            else
+            {
+                (above->_left == top ? above->_left : above->_right) = nullptr;
+                top->_parent = nullptr;
+                refresh_path(above);
+            }
+            std::size_t released = 0;
+            Node<T, Aggregate> *node = top;
+            while (node != nullptr)
+            {
+                prefetch_children(node);
+                if (node->_left != nullptr)
+                {
+                    node = node->_left;
+                    continue;
+                }
+                if (node->_right != nullptr)
+                {
+                    node = node->_right;
+                    continue;
+                }
+                Node<T, Aggregate> *parent = node->_parent;
+                if (parent != nullptr)
+                {
+                    (parent->_left == node ? parent->_left : parent->_right) = nullptr;
+                }
+                release_node(node);
+                ++released;
+                node = parent;
+            }
+            return released;
+        }
+
+        /*
+         * A valid handle or iterator may still point into a subtree that was extracted
+         * or grafted elsewhere; climbing to the root tells whether node is in this tree.
+         * O(depth).
+         */
+        Node<T, Aggregate> *owned(Node<T, Aggregate> *node) const
+        {
+            Node<T, Aggregate> *top = node;
+            while (top->_parent != nullptr)
+            {
+                top = top->_parent;
+            }
+            if (top != this->_root)
+            {
+                throw std::invalid_argument("node is not in this tree");
+            }
+            return node;
+        }
+
+        BinaryTree extract(Node<T, Aggregate> *top)
+        {
+            owned(top);
+            Node<T, Aggregate> *above = top->_parent;
+            if (top == this->_root)
+            {
+                this->_root = nullptr;
+            }
+            else
+            {
+                (above->_left == top ? above->_left : above->_right) = nullptr;
+                top->_parent = nullptr;
+                refresh_path(above);
+            }
+            BinaryTree out;
+            out._root = top;
+            out.share_arenas(*this);
+            return out;
+        }
+
+        node_handle graft(Node<T, Aggregate> *target, bool left, BinaryTree &tree)
+        {
+            if (&tree == this)
+            {
+                throw std::invalid_argument("cannot graft a tree onto itself");
+            }
+            owned(target);
+            Node<T, Aggregate> *&slot = left ? target->_left : target->_right;
+            if (slot != nullptr)
+            {
+                release_subtree(slot);
+            }
+            if (tree._root == nullptr)
+            {
+                return node_handle();
+            }
+            slot = tree._root;
+            slot->_parent = target;
+            tree._root = nullptr;
+            this->share_arenas(tree);
+            refresh_path(target);
+            return node_handle(slot);
+        }
+
+        /*
+         * Links nodes for a sequence where every node precedes its subtrees (preorder,
+         * or reversed postorder) against the matching inorder (reversed for postorder).
+         * leftFirst tells whether the left subtree follows the node: true for preorder.
+         */
+        template <typename Sequence, typename Inorder>
+        void link_traversals(Sequence seq, Sequence seqEnd, Inorder in, Inorder inEnd, bool leftFirst)
+        {
+            auto n = static_cast<std::size_t>(std::distance(seq, seqEnd));
+            if (n != static_cast<std::size_t>(std::distance(in, inEnd)))
+            {
+                throw std::invalid_argument("traversals have different lengths");
+            }
+            if (n == 0)
+            {
+                return;
+            }
+            Arena &arena = reserve_arena(n);
+
+            struct ValueHash
+            {
+                std::size_t operator()(const T *val) const { return Hash()(*val); }
+            };
+            struct ValueEqual
+            {
+                bool operator()(const T *a, const T *b) const { return KeyEqual()(*a, *b); }
+            };
+            std::unordered_set<const T *, ValueHash, ValueEqual> seen(n);
+
+            std::vector<Node<T, Aggregate> *> open;
+            for (; seq != seqEnd; ++seq)
+            {
+                Node<T, Aggregate> *node = arena_node(arena, *seq);
+                if (!seen.insert(&node->_value).second)
+                {
+                    throw std::invalid_argument("traversal values are not distinct");
+                }
+                if (this->_root == nullptr)
+                {
+                    this->_root = node;
+                    open.push_back(node);
+                    continue;
+                }
+                Node<T, Aggregate> *closed = nullptr;
+                while (!open.empty() && in != inEnd && KeyEqual()(open.back()->_value, *in))
+                {
+                    closed = open.back();
+                    open.pop_back();
+                    ++in;
+                }
+                Node<T, Aggregate> *parent = closed != nullptr ? closed : (open.empty() ? nullptr : open.back());
+                if (parent == nullptr)
+                {
+                    throw std::invalid_argument("traversals do not describe one tree");
+                }
+                bool asFirst = closed == nullptr;
+                (asFirst == leftFirst ? parent->_left : parent->_right) = node;
+                node->_parent = parent;
+                open.push_back(node);
+            }
+        }
+
+        std::size_t count_preorder()
+        {
+            std::size_t count = 0;
+            for (auto it = this->begin_preorder(); it != this->end_preorder(); ++it)
+            {
+                ++count;
+            }
+            return count;
+        }
+
+        template <typename Expected>
+        void verify(iterator (BinaryTree::*begin)(), iterator (BinaryTree::*end)(), Expected expected, Expected expectedEnd)
+        {
+            for (auto it = (this->*begin)(); it != (this->*end)(); ++it, ++expected)
+            {
+                if (expected == expectedEnd || !KeyEqual()(*it, *expected))
+                {
+                    throw std::invalid_argument("traversals do not describe one tree");
+                }
+            }
+            if (expected != expectedEnd)
+            {
+                throw std::invalid_argument("traversals do not describe one tree");
+            }
+        }
+
+        void clear()
+        {
+            if (this->_root != nullptr)
+            {
+                release_subtree(this->_root);
+            }
+        }
+
+        static Node<T, Aggregate> *at(const iterator &it)
+        {
+            if (it.ptr_current == nullptr)
+            {
+                throw std::invalid_argument("iterator is past the end");
+            }
+            return it.ptr_current;
+        }
+
+        // first node of each order within the subtree of top; the iterator stops after its last one
+        static iterator preorder_from(Node<T, Aggregate> *top)
+        {
+            return iterator(top, iterator::Order::PREORDER);
+        }
+
+        static iterator inorder_from(Node<T, Aggregate> *top)
+        {
+            if (top == nullptr)
+            {
+                return iterator(nullptr, iterator::Order::INORDER);
+            }
+            Node<T, Aggregate> *p = top;
+            while (p->_left != nullptr)
+            {
+                p = p->_left;
+            }
+            return iterator(top, p, iterator::Order::INORDER);
+        }
+
+        static iterator postorder_from(Node<T, Aggregate> *top)
+        {
+            if (top == nullptr)
+            {
+                return iterator(nullptr, iterator::Order::POSTORDER);
+            }
+            Node<T, Aggregate> *p = top;
+            while (p->_left != nullptr || p->_right != nullptr)
+            {
+                p = p->_left != nullptr ? p->_left : p->_right;
+            }
+            return iterator(top, p, iterator::Order::POSTORDER);
+        }
+
+        Node<T, Aggregate> *checked(const node_handle &handle) const
+        {
+            if (!this->valid(handle))
+            {
+                throw std::invalid_argument("stale node handle");
+            }
+            return handle._node;
+        }
+
+        void destroy_free_list()
+        {
+            while (this->_free != nullptr)
+            {
+                Node<T, Aggregate> *next = this->_free->_right;
+                if (!this->_free->_arena)
+                {
+                    delete this->_free;
+                    Counters::on_free();
+                }
+                this->_free = next;
+            }
+        }
+
+        template <typename F>
+        static Visit visit(F &f, T &value)
+        {
+            if constexpr (std::is_void_v<std::invoke_result_t<F &, T &>>)
+            {
+                f(value);
+                return Visit::CONTINUE;
+            }
+            else
+            {
+                return f(value);
+            }
+        }
+
+        /*
+         * Preorder search that climbs back through the parent pointers instead of
+         * recursing, so it uses constant stack on any shape. Returns the first match
+         * in preorder, or nullptr. The key may be any type KeyEqual compares with T, such
+         * as std::string_view or const char * for a std::string tree; it is never converted.
+         */
+        template <typename K>
+        Node<T, Aggregate> *find_node(const K &val) const
+        {
+            Node<T, Aggregate> *node = this->_root;
+            std::size_t depth = 1;
+            while (node != nullptr)
+            {
+                Counters::on_find_visit();
+                Counters::on_depth(depth);
+                prefetch_children(node);
+                if (KeyEqual()(node->_value, val))
+                {
+                    return node;
+                }
+                if (node->_left != nullptr || node->_right != nullptr)
+                {
+                    node = node->_left != nullptr ? node->_left : node->_right;
+                    ++depth;
+                    continue;
+                }
+                while (node->_parent != nullptr && (node == node->_parent->_right || node->_parent->_right == nullptr))
+                {
+                    node = node->_parent;
+                    --depth;
+                }
+                node = node->_parent != nullptr ? node->_parent->_right : nullptr;
+            }
+            return nullptr;
+        }
+
+        Node<T, Aggregate> *set_child(Node<T, Aggregate> *parent, Side side, const T &child)
+        {
+            Node<T, Aggregate> *&slot = side == Side::LEFT ? parent->_left : parent->_right;
+            if (slot == nullptr)
+            {
+                slot = new_node(child);
+                slot->_parent = parent;
+            }
+            else
+            {
+                slot->_value = child;
+            }
+            refresh_path(slot);
+            return slot;
+        }
+
+        template <typename K>
+        Node<T, Aggregate> *find_parent(const K &parent) const
+        {
+            if (this->_root == nullptr)
+            {
+                throw std::invalid_argument("root is null");
+            }
+            Node<T, Aggregate> *parentNode = find_node(parent);
+            if (parentNode == nullptr)
+            {
+                throw std::invalid_argument("First value is not in the tree.");
+            }
+            return parentNode;
+        }
+
+        static std::vector<difference> differences(const BinaryTree &a, const BinaryTree &b)
+        {
+            std::vector<difference> out;
+            SmallBuffer<std::pair<Node<T, Aggregate> *, Node<T, Aggregate> *>, 64> pending;
+            pending.push_back({a._root, b._root});
+            while (!pending.empty())
+            {
+                auto [x, y] = pending.back();
+                pending.pop_back();
+                if (x == nullptr || y == nullptr)
+                {
+                    if (x != y)
+                    {
+                        out.push_back({x != nullptr ? node_handle(x) : node_handle(), y != nullptr ? node_handle(y) : node_handle()});
+                    }
+                    continue;
+                }
+                if constexpr (is_merkle_aggregate<Aggregate>::value)
+                {
+                    if (x->_aggregate == y->_aggregate)
+                    {
+                        continue;
+                    }
+                }
+                if (!KeyEqual()(x->_value, y->_value))
+                {
+                    out.push_back({node_handle(x), node_handle(y)});
+                }
+                pending.push_back({x->_right, y->_right});
+                pending.push_back({x->_left, y->_left});
+            }
+            return out;
+        }
+
+        void printTree(std::ostream &os, const std::string &prefix, const Node<T, Aggregate> *node) const
+        {
+            if (node != nullptr)
+            {
+                bool hasLeft = node->_left != nullptr;
+                bool hasRight = node->_right != nullptr;
+                if (!hasLeft && !hasRight)
+                {
+                    return;
+                }
+
+                os << prefix;
+                os << ((hasLeft && hasRight) ? "├──" : "");
+                os << ((!hasLeft && hasRight) ? "└── " : "");
+
+                if (hasRight)
+                {
+                    bool printStrand = (hasLeft && hasRight && (node->_right->_right != nullptr || node->_right->_left != nullptr));
+                    std::string newPrefix = prefix + (printStrand ? "│   " : "    ");
+                    os << "R " << node->_right->_value << std::endl;
+                    printTree(os, newPrefix, node->_right);
+                }
+
+                if (hasLeft)
+                {
+                    std::cout << (hasRight ? prefix : "") << "└──L " << node->_left->_value << std::endl;
+                    printTree(os, prefix + "    ", node->_left);
+                }
+            }
+        }
+
+    public:
+        BinaryTree() : _root(nullptr) {}
+        BinaryTree(BinaryTree &tree)
+        {
+            this->add_root(tree._root->_value);
+            for (auto it = tree.begin_preorder(); it != tree.end_preorder(); ++it)
+            {
+                if (it.has_left())
+                {
+                    this->add_left(*it, it.Node()._left->_value);
+                }
+                if (it.has_right())
+                {
+                    this->add_right(*it, it.Node()._right->_value);
+                }
+            }
+        }
+        BinaryTree(BinaryTree &&tree) noexcept
+        {
+            this->_root = tree._root;
+            this->_free = tree._free;
+            this->_arenas = std::move(tree._arenas);
+            tree._root = nullptr;
+            tree._free = nullptr;
+        }
+        ~BinaryTree()
+        {
+            this->clear();
+            this->destroy_free_list();
+        }
+        BinaryTree &operator=(BinaryTree tree)
+        {
+            if (this == &tree)
+            {
+                return *this;
+            }
+            this->clear();
+            this->add_root(tree._root->_value);
+            for (auto it = tree.begin_preorder(); it != tree.end_preorder(); ++it)
+            {
+                if (it.has_left())
+                {
+                    this->add_left(*it, it.Node()._left->_value);
+                }
+                if (it.has_right())
+                {
+                    this->add_right(*it, it.Node()._right->_value);
+                }
+            }
+            return *this;
+        }
+        BinaryTree &operator=(BinaryTree &&tree) noexcept
+        {
+            if (this == &tree)
+            {
+                return *this;
+            }
+            this->clear();
+            this->destroy_free_list();
+            this->_root = tree._root;
+            this->_free = tree._free;
+            this->_arenas = std::move(tree._arenas);
+            tree._root = nullptr;
+            tree._free = nullptr;
+            return *this;
+        }
+
+        BinaryTree &add_root(T val)
+        {
+            if (this->_root == nullptr)
+            {
+                this->_root = new_node(val);
+            }
+            this->_root->_value = val;
+            refresh_path(this->_root);
+            return *this;
+        }
+
+        template <typename K>
+        BinaryTree &add_left(const K &parent, T child)
+        {
+            set_child(find_parent(parent), Side::LEFT, child);
+            return *this;
+        }
+
+        template <typename K>
+        BinaryTree &add_right(const K &parent, T child)
+        {
+            set_child(find_parent(parent), Side::RIGHT, child);
+            return *this;
+        }
+
+        /*
+         * Returns an inorder iterator at the first node holding val in preorder,
+         * or end() when there is none. Continuing with ++ walks the rest of the inorder.
+         * Like every lookup below, it accepts any key type comparable with T.
+         */
+        template <typename K>
+        iterator find(const K &val)
+        {
+            Node<T, Aggregate> *node = find_node(val);
+            if (node == nullptr)
+            {
+                return this->end();
+            }
+            iterator it(this->_root, node, iterator::Order::INORDER);
+            it.prev = node->_left; // the left subtree counts as already visited
+            return it;
+        }
+
+        template <typename K>
+        bool contains(const K &val) const
+        {
+            return find_node(val) != nullptr;
+        }
+
+        /*
+         * Like add_left/add_right, but report a missing parent (or an empty tree)
+         * by returning false instead of throwing.
+         */
+        template <typename K>
+        bool try_add_left(const K &parent, T child)
+        {
+            Node<T, Aggregate> *parentNode = find_node(parent);
+            if (parentNode == nullptr)
+            {
+                return false;
+            }
+            set_child(parentNode, Side::LEFT, child);
+            return true;
+        }
+
+        template <typename K>
+        bool try_add_right(const K &parent, T child)
+        {
+            Node<T, Aggregate> *parentNode = find_node(parent);
+            if (parentNode == nullptr)
+            {
+                return false;
+            }
+            set_child(parentNode, Side::RIGHT, child);
+            return true;
+        }
+
+        struct edge
+        {
+            T parent;
+            T child;
+            Side side;
+        };
+
+        /*
+         * Applies a batch of add_left/add_right edits with one preorder walk to index the
+         * tree by value instead of one find per edit, so k edits cost O(n + k).
+         * An edit whose parent value does not exist yet waits until an earlier or later
+         * edit in the batch creates it, so edits may be listed in any order.
+         * As with find, a value held by several nodes resolves to the first of them in
+         * preorder; when an edit renames that node, the value moves on to the next one,
+         * as it would for sequential add_left/add_right calls. Nodes the batch gives a
+         * value rank after the nodes that held it when the batch started, in the order
+         * the batch reaches them.
+         * Edits that never resolve throw std::invalid_argument after all others are applied.
+         */
+        template <typename Edges>
+        BinaryTree &add_edges(const Edges &edges)
+        {
+            if (this->_root == nullptr)
+            {
+                throw std::invalid_argument("root is null");
+            }
+            // every node that has held each value, first candidate in front; a node renamed
+            // since it was listed is dropped when it reaches the front
+            std::unordered_map<T, std::deque<Node<T, Aggregate> *>, Hash, KeyEqual> index;
+            for (auto it = this->begin_preorder(); it != this->end_preorder(); ++it)
+            {
+                index[*it].push_back(at(it));
+            }
+            auto lookup = [&index](const T &val) -> Node<T, Aggregate> * {
+                auto found = index.find(val);
+                if (found == index.end())
+                {
+                    return nullptr;
+                }
+                std::deque<Node<T, Aggregate> *> &nodes = found->second;
+                while (!nodes.empty() && !KeyEqual()(nodes.front()->_value, val))
+                {
+                    nodes.pop_front();
+                }
+                return nodes.empty() ? nullptr : nodes.front();
+            };
+
+            std::unordered_map<T, std::vector<const edge *>, Hash, KeyEqual> waiting;
+            std::queue<const edge *> ready;
+            for (const edge &e : edges)
+            {
+                ready.push(&e);
+                while (!ready.empty())
+                {
+                    const edge *next = ready.front();
+                    ready.pop();
+                    Node<T, Aggregate> *parent = lookup(next->parent);
+                    if (parent == nullptr)
+                    {
+                        waiting[next->parent].push_back(next);
+                        continue;
+                    }
+                    Node<T, Aggregate> *&slot = next->side == Side::LEFT ? parent->_left : parent->_right;
+                    if (slot == nullptr)
+                    {
+                        slot = new_node(next->child);
+                        slot->_parent = parent;
+                    }
+                    else
+                    {
+                        slot->_value = next->child;
+                    }
+                    refresh_path(slot);
+                    index[next->child].push_back(slot);
+                    auto unblocked = waiting.find(next->child);
+                    if (unblocked != waiting.end())
+                    {
+                        for (const edge *w : unblocked->second)
+                        {
+                            ready.push(w);
+                        }
+                        waiting.erase(unblocked);
+                    }
+                }
+            }
+            if (!waiting.empty())
+            {
+                throw std::invalid_argument("First value is not in the tree.");
+            }
+            return *this;
+        }
+
+        /*
+         * Identifies a node of this tree without searching for its value.
+         * The generation recorded at creation detects handles to nodes the tree
+         * has since released. Handles must not outlive the tree.
+         *
+         * A handle follows its node when extract_subtree or graft moves it into another
+         * tree, and must be used with that tree from then on. The O(1) members that take
+         * a handle (value, aggregate, add_left, add_right and replace) do not check which
+         * tree holds the node: passing another tree's handle is a precondition violation
+         * that edits the other tree. depth, ancestors, extract_subtree and graft climb
+         * to the root anyway and throw std::invalid_argument for such a handle.
+         */
+        class node_handle
+        {
+        private:
+            Node<T, Aggregate> *_node = nullptr;
+            std::uint32_t _generation = 0;
+
+            friend class BinaryTree;
+            friend class LcaIndex<BinaryTree>;
+
+            explicit node_handle(Node<T, Aggregate> *node) : _node(node), _generation(node->_generation) {}
+
+        public:
+            node_handle() = default;
+
+            bool operator==(const node_handle &rhs) const
+            {
+                return this->_node == rhs._node && this->_generation == rhs._generation;
+            }
+
+            bool operator!=(const node_handle &rhs) const
+            {
+                return !(*this == rhs);
+            }
+        };
+
+        bool valid(node_handle handle) const
+        {
+            return handle._node != nullptr && handle._node->_generation == handle._generation;
+        }
+
+        node_handle root_handle() const
+        {
+            if (this->_root == nullptr)
+            {
+                throw std::invalid_argument("root is null");
+            }
+            return node_handle(this->_root);
+        }
+
+        node_handle handle(iterator it) const
+        {
+            return node_handle(at(it));
+        }
+
+        T &value(node_handle handle)
+        {
+            return checked(handle)->_value;
+        }
 
-        Node<T> *find(T val)
+        /*
+         * The values on the path from a node up to the root, the node itself first:
+         * for (const T &v : tree.ancestors(h)). The range is a view over the parent
+         * pointers; it is invalidated by removing any node on the path. Checking that
+         * the node is in this tree walks the same path once, in O(depth).
+         */
+        ancestor_range<T, Aggregate> ancestors(node_handle handle) const
         {
-            if (this->_root == nullptr)
-            {
-                throw std::invalid_argument("root is null");
-            }
-            return find(val, this->_root);
+            return ancestor_range<T, Aggregate>(owned(checked(handle)));
         }
 
-        Node<T> *find(T val, Node<T> *currentNode)
+        ancestor_range<T, Aggregate> ancestors(const iterator &it) const
         {
-            Node<T> *node1 = nullptr;
-            Node<T> *node2 = nullptr;
-            if (val == currentNode->_value)
-            {
-                return currentNode;
-            }
-            if ((currentNode->_left == nullptr) && (currentNode->_right == nullptr))
-            {
-                return nullptr;
-            }
-            if (currentNode->_left != nullptr)
-            {
-                node1 = find(val, currentNode->_left);
-            }
-            if (node1 != nullptr)
-            {
-                return node1;
-            }
-            if (currentNode->_right != nullptr)
+            return ancestor_range<T, Aggregate>(owned(at(it)));
+        }
+
+        /*
+         * Number of edges between a node and the root (the root has depth 0), counted
+         * by climbing the parent pointers in O(depth). The climb ends at the root of the
+         * tree that holds the node, which must be this one.
+         */
+        std::size_t depth(node_handle handle) const
+        {
+            std::size_t edges = 0;
+            Node<T, Aggregate> *top = checked(handle);
+            for (; top->_parent != nullptr; top = top->_parent)
             {
-                node2 = find(val, currentNode->_right);
+                ++edges;
             }
-            if (node2 != nullptr)
+            if (top != this->_root)
             {
-                return node2;
+                throw std::invalid_argument("node is not in this tree");
             }
-            return nullptr;
+            return edges;
         }
 
-        void printTree(std::ostream &os, const std::string &prefix, const Node<T> *node) const
+        /*
+         * The Aggregate over the subtree below a node, or over the whole tree (identity
+         * when it is empty), read from the node in O(1). Every edit through the tree keeps
+         * it current; assigning through an iterator or value() does not, so change values
+         * with replace() in an aggregated tree.
+         */
+        auto aggregate(node_handle handle) const
         {
-            if (node != nullptr)
+            static_assert(!std::is_same_v<Aggregate, NoAggregate>, "the tree has no Aggregate policy");
+            return checked(handle)->_aggregate;
+        }
+
+        auto aggregate(const iterator &it) const
+        {
+            static_assert(!std::is_same_v<Aggregate, NoAggregate>, "the tree has no Aggregate policy");
+            return at(it)->_aggregate;
+        }
+
+        auto aggregate() const
+        {
+            static_assert(!std::is_same_v<Aggregate, NoAggregate>, "the tree has no Aggregate policy");
+            return aggregate_of(this->_root);
+        }
+
+        /*
+         * The inner aggregate of the values at inorder positions first..last (inclusive,
+         * counted from 0), for trees whose policy is a SizedAggregate. Descends once to the
+         * node where the two positions part and then along each boundary, so it costs
+         * O(height) and touches no node outside those paths. Values combine in inorder.
+         */
+        auto range_aggregate(std::size_t first, std::size_t last) const
+        {
+            static_assert(is_sized_aggregate<Aggregate>::value, "range_aggregate needs a SizedAggregate policy");
+            using Inner = typename Aggregate::inner;
+            if (first > last || last >= aggregate_of(this->_root).size)
             {
-                bool hasLeft = node->_left != nullptr;
-                bool hasRight = node->_right != nullptr;
-                if (!hasLeft && !hasRight)
+                throw std::invalid_argument("position out of range");
+            }
+
+            // the node where first and last part: first <= position <= last
+            Node<T, Aggregate> *split = this->_root;
+            std::size_t offset = 0; // inorder position where split's subtree starts
+            std::size_t position = offset + aggregate_of(split->_left).size;
+            while (last < position || first > position)
+            {
+                if (last < position)
                 {
-                    return;
+                    split = split->_left;
                 }
-
-                os << prefix;
-                os << ((hasLeft && hasRight) ? "├──" : "");
-                os << ((!hasLeft && hasRight) ? "└── " : "");
-
-                if (hasRight)
+                else
                 {
-                    bool printStrand = (hasLeft && hasRight && (node->_right->_right != nullptr || node->_right->_left != nullptr));
-                    std::string newPrefix = prefix + (printStrand ? "│   " : "    ");
-                    os << "R " << node->_right->_value << std::endl;
-                    printTree(os, newPrefix, node->_right);
+                    offset = position + 1;
+                    split = split->_right;
                 }
+                position = offset + aggregate_of(split->_left).size;
+            }
 
-                if (hasLeft)
+            // suffix of the left subtree from first, gathered right to left
+            auto left = Inner::identity();
+            std::size_t start = offset;
+            for (Node<T, Aggregate> *node = split->_left; node != nullptr;)
+            {
+                std::size_t at = start + aggregate_of(node->_left).size;
+                if (first <= at)
                 {
-                    std::cout << (hasRight ? prefix : "") << "└──L " << node->_left->_value << std::endl;
-                    printTree(os, prefix + "    ", node->_left);
+                    left = Inner::combine(Inner::combine(Inner::lift(node->_value), aggregate_of(node->_right).value), left);
+                    node = node->_left;
+                }
+                else
+                {
+                    start = at + 1;
+                    node = node->_right;
                 }
             }
-        }
 
-    public:
-        BinaryTree<T>() : _root(nullptr) {}
-        BinaryTree<T>(BinaryTree<T> &tree)
-        {
-            this->add_root(tree._root->_value);
-            for (auto it = tree.begin_preorder(); it != tree.end_preorder(); ++it)
+            // prefix of the right subtree up to last, gathered left to right
+            auto right = Inner::identity();
+            start = position + 1;
+            for (Node<T, Aggregate> *node = split->_right; node != nullptr;)
             {
-                if (it.has_left())
+                std::size_t at = start + aggregate_of(node->_left).size;
+                if (last >= at)
                 {
-                    this->add_left(*it, it.Node()._left->_value);
+                    right = Inner::combine(right, Inner::combine(aggregate_of(node->_left).value, Inner::lift(node->_value)));
+                    start = at + 1;
+                    node = node->_right;
                 }
-                if (it.has_right())
+                else
                 {
-                    this->add_right(*it, it.Node()._right->_value);
+                    node = node->_left;
                 }
             }
+            return Inner::combine(Inner::combine(left, Inner::lift(split->_value)), right);
         }
-        BinaryTree<T>(BinaryTree<T> &&tree) noexcept
+
+        /*
+         * O(1) insert below a handle; like add_left(T, T), an existing child keeps
+         * its node and only has its value replaced. Returns the child's handle.
+         */
+        node_handle add_left(node_handle parent, T child)
         {
-            this->_root = tree._root;
-            tree._root = nullptr;
+            return node_handle(set_child(checked(parent), Side::LEFT, child));
+        }
+
+        node_handle add_right(node_handle parent, T child)
+        {
+            return node_handle(set_child(checked(parent), Side::RIGHT, child));
         }
-        ~BinaryTree<T>()
+
+        /*
+         * Editing at an iterator position works on it.Node() directly, without find.
+         * Every edit first climbs to the root to check that the node is in this tree,
+         * in O(depth): an iterator into another tree, or into a subtree that was extracted
+         * or grafted away, throws std::invalid_argument.
+         *
+         * insert_left/insert_right and replace invalidate nothing: every iterator and
+         * handle keeps pointing at its node. A walk already in progress may however
+         * skip a node inserted during it, or visit it out of order, because iterators
+         * cache their last node and their direction on construction.
+         *
+         * erase_subtree invalidates iterators positioned inside the erased subtree
+         * and walks whose last node is inside it; handles to erased nodes become
+         * stale and are rejected from then on. Erasing at the root empties the tree.
+         */
+        node_handle insert_left(iterator it, T child)
         {
-            std::queue<Node<T> *> toRemove;
-            for (auto it = this->begin_postorder(); it != this->end_postorder(); ++it)
-            {
-                Node<T> *n = &it.Node();
-                toRemove.push(n);
-            }
-            while (!toRemove.empty())
-            {
-                delete toRemove.front();
-                toRemove.pop();
-            }
+            return node_handle(set_child(owned(at(it)), Side::LEFT, child));
+        }
+
+        node_handle insert_right(iterator it, T child)
+        {
+            return node_handle(set_child(owned(at(it)), Side::RIGHT, child));
         }
-        BinaryTree<T> &operator=(BinaryTree<T> tree)
+
+        BinaryTree &replace(iterator it, T val)
         {
-            if (this == &tree)
+            Node<T, Aggregate> *node = owned(at(it));
+            node->_value = val;
+            refresh_path(node);
+            return *this;
+        }
+
+        BinaryTree &replace(node_handle handle, T val)
+        {
+            Node<T, Aggregate> *node = checked(handle);
+            node->_value = val;
+            refresh_path(node);
+            return *this;
+        }
+
+        std::size_t erase_subtree(iterator it)
+        {
+            return release_subtree(owned(at(it)));
+        }
+
+        /*
+         * Moves the subtree at a node into a new tree in O(1) by relinking its root;
+         * no node is copied or reallocated. Handles and iterators into the subtree keep
+         * pointing at the same nodes, which now belong to the returned tree. Checking
+         * that the node is in this tree costs O(depth); a node extracted earlier throws.
+         */
+        BinaryTree extract_subtree(node_handle handle)
+        {
+            return extract(checked(handle));
+        }
+
+        BinaryTree extract_subtree(iterator it)
+        {
+            return extract(at(it));
+        }
+
+        /*
+         * Makes the root of tree the left (right) child of target in O(1), releasing
+         * the subtree that was there. tree is left empty. Returns the handle of the
+         * grafted root, or an invalid handle if tree was empty. target must be in this
+         * tree (checked in O(depth)), which also rejects a target inside tree itself.
+         */
+        node_handle graft_left(node_handle target, BinaryTree &&tree)
+        {
+            return graft(checked(target), true, tree);
+        }
+
+        node_handle graft_left(iterator target, BinaryTree &&tree)
+        {
+            return graft(at(target), true, tree);
+        }
+
+        node_handle graft_right(node_handle target, BinaryTree &&tree)
+        {
+            return graft(checked(target), false, tree);
+        }
+
+        node_handle graft_right(iterator target, BinaryTree &&tree)
+        {
+            return graft(at(target), false, tree);
+        }
+
+        /*
+         * Rebuilds a tree from its preorder (or postorder) and inorder sequences in O(n):
+         * one arena holds every node and a stack of open ancestors replaces the per-value
+         * find. Values must be distinct; duplicates, sequences of different lengths or
+         * sequences that do not describe one tree throw std::invalid_argument. The result
+         * is verified by walking it with its own iterators.
+         */
+        template <typename PreorderRange, typename InorderRange>
+        static BinaryTree from_preorder_inorder(const PreorderRange &preorder, const InorderRange &inorder)
+        {
+            BinaryTree tree;
+            tree.link_traversals(std::begin(preorder), std::end(preorder), std::begin(inorder), std::end(inorder), true);
+            tree.verify(&BinaryTree::begin_preorder, &BinaryTree::end_preorder, std::begin(preorder), std::end(preorder));
+            tree.verify(&BinaryTree::begin_inorder, &BinaryTree::end_inorder, std::begin(inorder), std::end(inorder));
+            tree.refresh_all();
+            return tree;
+        }
+
+        template <typename PostorderRange, typename InorderRange>
+        static BinaryTree from_postorder_inorder(const PostorderRange &postorder, const InorderRange &inorder)
+        {
+            BinaryTree tree;
+            tree.link_traversals(std::rbegin(postorder), std::rend(postorder), std::rbegin(inorder), std::rend(inorder), false);
+            tree.verify(&BinaryTree::begin_postorder, &BinaryTree::end_postorder, std::begin(postorder), std::end(postorder));
+            tree.verify(&BinaryTree::begin_inorder, &BinaryTree::end_inorder, std::begin(inorder), std::end(inorder));
+            tree.refresh_all();
+            return tree;
+        }
+
+        /*
+         * Builds a tree where node i holds values[i] and hangs below node parents[i],
+         * on the left when is_left[i] is true. A negative parent marks the root.
+         * Nodes are created in one arena and linked by index in O(n), without any value
+         * lookup, so values may repeat. Out-of-range parents, two children on one side,
+         * a missing or second root, or nodes unreachable from the root throw
+         * std::invalid_argument.
+         */
+        template <typename Values, typename Parents, typename Sides>
+        static BinaryTree from_parent_array(const Values &values, const Parents &parents, const Sides &is_left)
+        {
+            BinaryTree tree;
+            auto n = static_cast<std::size_t>(std::distance(std::begin(values), std::end(values)));
+            if (n != static_cast<std::size_t>(std::distance(std::begin(parents), std::end(parents))) ||
+                n != static_cast<std::size_t>(std::distance(std::begin(is_left), std::end(is_left))))
             {
-                return *this;
+                throw std::invalid_argument("arrays have different lengths");
             }
-            std::queue<Node<T> *> toRemove;
-            for (auto it = this->begin_postorder(); it != this->end_postorder(); ++it)
+            if (n == 0)
             {
-                Node<T> *n = &it.Node();
-                toRemove.push(n);
+                return tree;
             }
-            while (!toRemove.empty())
+            Arena &arena = tree.reserve_arena(n);
+            for (const auto &val : values)
             {
-                delete toRemove.front();
-                toRemove.pop();
+                arena_node(arena, val);
             }
-            this->_root = nullptr;
-            this->add_root(tree._root->_value);
-            for (auto it = tree.begin_preorder(); it != tree.end_preorder(); ++it)
+
+            auto parent = std::begin(parents);
+            auto side = std::begin(is_left);
+            for (std::size_t i = 0; i < n; ++i, ++parent, ++side)
             {
-                if (it.has_left())
+                Node<T, Aggregate> *node = &arena[i];
+                if (*parent < 0)
                 {
-                    this->add_left(*it, it.Node()._left->_value);
+                    if (tree._root != nullptr)
+                    {
+                        throw std::invalid_argument("more than one root");
+                    }
+                    tree._root = node;
+                    continue;
                 }
-                if (it.has_right())
+                auto p = static_cast<std::size_t>(*parent);
+                if (p >= n)
                 {
-                    this->add_right(*it, it.Node()._right->_value);
+                    throw std::invalid_argument("parent index out of range");
+                }
+                Node<T, Aggregate> *&slot = *side ? arena[p]._left : arena[p]._right;
+                if (slot != nullptr)
+                {
+                    throw std::invalid_argument("two children on the same side");
                 }
+                slot = node;
+                node->_parent = &arena[p];
             }
-            return *this;
-        }
-        BinaryTree &operator=(BinaryTree<T> &&tree) noexcept
-        {
-            if (this == &tree)
+            if (tree._root == nullptr || tree.count_preorder() != n)
             {
-                return *this;
+                throw std::invalid_argument("nodes are not all reachable from one root");
             }
-            std::queue<Node<T> *> toRemove;
-            for (auto it = this->begin_postorder(); it != this->end_postorder(); ++it)
+            tree.refresh_all();
+            return tree;
+        }
+
+        /*
+         * Builds a tree from a heap-indexed level-order array: the children of position i
+         * are at 2i+1 and 2i+2, and null_marker marks an absent node. One arena holds the
+         * nodes and a single pass links each one to its parent. Values may repeat; a node
+         * below an absent position throws std::invalid_argument.
+         */
+        template <typename Values>
+        static BinaryTree from_level_order(const Values &values, const T &null_marker)
+        {
+            BinaryTree tree;
+            std::size_t present = 0;
+            for (const auto &val : values)
             {
-                toRemove.push(&(it.Node()));
+                present += KeyEqual()(val, null_marker) ? 0U : 1U;
             }
-            while (!toRemove.empty())
+            if (present == 0)
             {
-                delete toRemove.front();
+                return tree;
             }
-
-            this->add_root(tree._root->_value);
-            for (auto it = tree.begin_preorder(); it != tree.end_preorder(); ++it)
+            Arena &arena = tree.reserve_arena(present);
+            std::vector<Node<T, Aggregate> *> byPosition;
+            byPosition.reserve(static_cast<std::size_t>(std::distance(std::begin(values), std::end(values))));
+            for (const auto &val : values)
             {
-                if (it.has_left())
+                std::size_t i = byPosition.size();
+                if (KeyEqual()(val, null_marker))
                 {
-                    this->add_left(*it, it.Node()._left->_value);
+                    byPosition.push_back(nullptr);
+                    continue;
                 }
-                if (it.has_right())
+                Node<T, Aggregate> *node = arena_node(arena, val);
+                byPosition.push_back(node);
+                if (i == 0)
                 {
-                    this->add_right(*it, it.Node()._right->_value);
+                    tree._root = node;
+                    continue;
+                }
+                Node<T, Aggregate> *parent = byPosition[(i - 1) / 2];
+                if (parent == nullptr)
+                {
+                    throw std::invalid_argument("node below an absent position");
                 }
+                (i % 2 == 1 ? parent->_left : parent->_right) = node;
+                node->_parent = parent;
             }
+            tree.refresh_all();
+            return tree;
         }
 
-        BinaryTree<T> &add_root(T val)
+        /*
+         * Equal when both trees have the same shape and KeyEqual-equal values at every
+         * position. With a MerkleAggregate the root hashes reject unequal trees in O(1);
+         * equal hashes, and trees without hashes, are confirmed by a lockstep walk.
+         */
+        friend bool operator==(const BinaryTree &a, const BinaryTree &b)
         {
-            if (this->_root == nullptr)
+            if constexpr (is_merkle_aggregate<Aggregate>::value)
             {
-                this->_root = new Node<T>(val);
+                if (aggregate_of(a._root) != aggregate_of(b._root))
+                {
+                    return false;
+                }
             }
-            this->_root->_value = val;
-            return *this;
+            SmallBuffer<std::pair<const Node<T, Aggregate> *, const Node<T, Aggregate> *>, 64> pending;
+            pending.push_back({a._root, b._root});
+            while (!pending.empty())
+            {
+                auto [x, y] = pending.back();
+                pending.pop_back();
+                if (x == nullptr || y == nullptr)
+                {
+                    if (x != y)
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+                if (!KeyEqual()(x->_value, y->_value))
+                {
+                    return false;
+                }
+                pending.push_back({x->_right, y->_right});
+                pending.push_back({x->_left, y->_left});
+            }
+            return true;
         }
 
-        BinaryTree<T> &add_left(T parent, T child)
+        friend bool operator!=(const BinaryTree &a, const BinaryTree &b)
         {
-            Node<T> *parentNode = find(parent);
-            if (parentNode == nullptr)
-            {
-                throw std::invalid_argument("First value is not in the tree.");
-            }
-            if (parentNode->_left == nullptr)
-            {
-                parentNode->add_left(child);
-            }
-            else
-            {
-                parentNode->_left->_value = child;
-            }
-            return *this;
+            return !(a == b);
         }
 
-        BinaryTree<T> &add_right(T parent, T child)
+        /*
+         * One position where two trees differ: both handles valid when the values there
+         * differ, only one valid when a subtree exists in one tree and not the other.
+         */
+        struct difference
         {
-            Node<T> *parentNode = find(parent);
-            if (parentNode == nullptr)
-            {
-                throw std::invalid_argument("First value is not in the tree.");
-            }
-            if (parentNode->_right == nullptr)
-            {
-                parentNode->add_right(child);
-            }
-            else
-            {
-                parentNode->_right->_value = child;
-            }
-            return *this;
+            node_handle left;
+            node_handle right;
+        };
+
+        /*
+         * Walks a and b in lockstep by position and reports every difference in preorder.
+         * A subtree present on one side only is reported once, at its root. With a
+         * MerkleAggregate, positions whose subtree hashes match are skipped without
+         * descending, so the cost follows the size of the changes rather than of the trees.
+         */
+        friend std::vector<difference> diff(const BinaryTree &a, const BinaryTree &b)
+        {
+            return differences(a, b);
         }
 
-        friend std::ostream &operator<<(std::ostream &os, const BinaryTree<T> &tree)
+        friend std::ostream &operator<<(std::ostream &os, const BinaryTree &tree)
         {
             os << tree._root->_value << std::endl;
             tree.printTree(os, "", tree._root);
@@ -249,32 +1345,45 @@ namespace ariel
             };
 
         private:
-            Node<T> *ptr_current;
-            Node<T> *_root;
-            Node<T> *prev = nullptr;
-            Node<T> *last;
+            Node<T, Aggregate> *ptr_current;
+            Node<T, Aggregate> *_root;
+            Node<T, Aggregate> *prev = nullptr;
+            Node<T, Aggregate> *last;
             Order _type; // 0 = preorder, 1 = inorder, 2 = postorder
 
+            friend class BinaryTree;
+
             void left()
             {
+                Counters::on_hop();
                 this->prev = this->ptr_current;
                 this->ptr_current = this->ptr_current->_left;
+                if (this->ptr_current != nullptr)
+                {
+                    prefetch_children(this->ptr_current);
+                }
             }
 
             void right()
             {
+                Counters::on_hop();
                 this->prev = this->ptr_current;
                 this->ptr_current = this->ptr_current->_right;
+                if (this->ptr_current != nullptr)
+                {
+                    prefetch_children(this->ptr_current);
+                }
             }
 
             void up()
             {
+                Counters::on_hop();
                 this->prev = this->ptr_current;
                 this->ptr_current = this->ptr_current->_parent;
             }
 
         public:
-            iterator(Node<T> *root, Node<T> *curr, Order type) : _type(type), _root(root), ptr_current(curr)
+            iterator(Node<T, Aggregate> *root, Node<T, Aggregate> *curr, Order type) : _type(type), _root(root), ptr_current(curr)
             {
                 this->last = this->_root;
                 if (this->_root != nullptr)
@@ -290,7 +1399,7 @@ namespace ariel
                     }
                 }
             }
-            iterator(Node<T> *root, Order type) : _type(type), _root(root)
+            iterator(Node<T, Aggregate> *root, Order type) : _type(type), _root(root)
             {
                 this->ptr_current = root;
                 this->last = this->_root;
@@ -322,7 +1431,7 @@ namespace ariel
                 }
             }
 
-            Node<T> &Node()
+            Node<T, Aggregate> &Node()
             {
                 return *(this->ptr_current);
             }
@@ -560,11 +1669,7 @@ namespace ariel
 
         iterator begin_preorder()
         {
-            if (this->_root == nullptr)
-            {
-                return iterator(nullptr, iterator::Order::PREORDER);
-            }
-            return iterator(this->_root, iterator::Order::PREORDER);
+            return preorder_from(this->_root);
         }
         iterator end_preorder()
         {
@@ -573,16 +1678,7 @@ namespace ariel
 
         iterator begin_inorder()
         {
-            if (this->_root == nullptr)
-            {
-                return iterator(nullptr, iterator::Order::INORDER);
-            }
-            Node<T> *p = this->_root;
-            while (p->_left != nullptr)
-            {
-                p = p->_left;
-            }
-            return iterator(this->_root, p, iterator::Order::INORDER);
+            return inorder_from(this->_root);
         }
         iterator end_inorder()
         {
@@ -591,27 +1687,155 @@ namespace ariel
 
         iterator begin_postorder()
         {
-            if (this->_root == nullptr)
+            return postorder_from(this->_root);
+        }
+        iterator end_postorder()
+        {
+            return iterator(nullptr, iterator::Order::POSTORDER);
+        }
+
+        /*
+         * Iterate only the subtree rooted at a node: the iterator ends (compares equal to
+         * the matching end_*()) after the subtree's last node in that order, without
+         * climbing above its root. Costs O(subtree size) whatever the size of the tree.
+         */
+        iterator begin_preorder(node_handle top)
+        {
+            return preorder_from(checked(top));
+        }
+        iterator begin_preorder(const iterator &top)
+        {
+            return preorder_from(at(top));
+        }
+
+        iterator begin_inorder(node_handle top)
+        {
+            return inorder_from(checked(top));
+        }
+        iterator begin_inorder(const iterator &top)
+        {
+            return inorder_from(at(top));
+        }
+
+        iterator begin_postorder(node_handle top)
+        {
+            return postorder_from(checked(top));
+        }
+        iterator begin_postorder(const iterator &top)
+        {
+            return postorder_from(at(top));
+        }
+
+        /*
+         * Explicit-stack alternative to the parent-climbing iterators (see StackIterator.hpp),
+         * for any order including level order: for (int v : tree.walk<Walk::LEVEL_ORDER>()).
+         */
+        template <Walk W>
+        stack_range<T, W, Aggregate> walk()
+        {
+            return stack_range<T, W, Aggregate>(this->_root);
+        }
+
+        /*
+         * Internal iteration: f(value) runs inside one loop over an explicit stack (inline
+         * up to 64 levels, see SmallBuffer), so it can be inlined and no iterator state is
+         * rebuilt between elements. f may return a Visit:
+         * STOP ends the walk;
+         * SKIP in preorder skips the node's children,
+         * in inorder its right subtree (the left one was already visited),
+         * and in postorder, where the subtree is already done, acts as CONTINUE.
+         */
+        template <typename F>
+        void for_each_preorder(F &&f)
+        {
+            SmallBuffer<Node<T, Aggregate> *, 64> pending;
+            Node<T, Aggregate> *node = this->_root;
+            while (node != nullptr)
             {
-                return iterator(nullptr, iterator::Order::POSTORDER);
+                prefetch_children(node);
+                Visit next = visit(f, node->_value);
+                if (next == Visit::STOP)
+                {
+                    return;
+                }
+                Node<T, Aggregate> *right = node->_right;
+                node = next == Visit::SKIP ? nullptr : node->_left;
+                if (right != nullptr && next != Visit::SKIP)
+                {
+                    if (node == nullptr)
+                    {
+                        node = right;
+                    }
+                    else
+                    {
+                        pending.push_back(right);
+                    }
+                }
+                if (node == nullptr && !pending.empty())
+                {
+                    node = pending.back();
+                    pending.pop_back();
+                }
             }
-            Node<T> *p = this->_root;
-            while (p->_left != nullptr || p->_right != nullptr)
+        }
+
+        template <typename F>
+        void for_each_inorder(F &&f)
+        {
+            SmallBuffer<Node<T, Aggregate> *, 64> pending;
+            Node<T, Aggregate> *node = this->_root;
+            while (true)
             {
-                if (p->_left != nullptr)
+                while (node != nullptr)
+                {
+                    pending.push_back(node);
+                    node = node->_left;
+                }
+                if (pending.empty())
                 {
-                    p = p->_left;
+                    return;
                 }
-                else if (p->_right != nullptr)
+                node = pending.back();
+                pending.pop_back();
+                prefetch(node->_right);
+                Visit next = visit(f, node->_value);
+                if (next == Visit::STOP)
                 {
-                    p = p->_right;
+                    return;
                 }
+                node = next == Visit::SKIP ? nullptr : node->_right;
             }
-            return iterator(this->_root, p, iterator::Order::POSTORDER);
         }
-        iterator end_postorder()
+
+        template <typename F>
+        void for_each_postorder(F &&f)
         {
-            return iterator(nullptr, iterator::Order::POSTORDER);
+            // the stack holds the path from the root to the next node to visit
+            SmallBuffer<Node<T, Aggregate> *, 64> pending;
+            Node<T, Aggregate> *node = this->_root;
+            while (true)
+            {
+                while (node != nullptr)
+                {
+                    pending.push_back(node);
+                    prefetch_children(node);
+                    node = node->_left != nullptr ? node->_left : node->_right;
+                }
+                if (pending.empty())
+                {
+                    return;
+                }
+                Node<T, Aggregate> *done = pending.back();
+                pending.pop_back();
+                if (visit(f, done->_value) == Visit::STOP)
+                {
+                    return;
+                }
+                if (!pending.empty() && pending.back()->_left == done)
+                {
+                    node = pending.back()->_right;
+                }
+            }
         }
 
         iterator begin()
@@ -623,4 +1847,10 @@ namespace ariel
             return this->end_inorder();
         }
     };
+
+    template <typename T, typename Aggregate>
+    using AggregateTree = BinaryTree<T, NoCounters, std::equal_to<>, std::hash<T>, Aggregate>;
+
+    template <typename T>
+    using MerkleTree = AggregateTree<T, MerkleAggregate<T>>;
 }
\ No newline at end of file
@@ -0,0 +1,269 @@
+#pragma once
+#include "BinaryTree.hpp"
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace ariel
+{
+    /*
+     * A node without a parent pointer (or generation): value plus two children.
+     */
+    template <typename T>
+    class CompactNode
+    {
+    public:
+        T _value;
+        CompactNode<T> *_left = nullptr;
+        CompactNode<T> *_right = nullptr;
+
+        CompactNode(const T &val) : _value(val) {}
+    };
+
+    /*
+     * A read-only snapshot of a BinaryTree in parent-free nodes, stored in one arena,
+     * for batch jobs that read a tree once. Copying a BinaryTree holds both trees at
+     * once; from_parent_array loads the nodes directly and never builds the larger one.
+     *
+     * Walks use Morris threading: they temporarily point the right child of each
+     * inorder predecessor back at its successor instead of keeping a stack, and undo
+     * every thread before returning. They need O(1) extra memory, but the tree is
+     * inconsistent while a walk is in progress. Do not read the tree from other threads,
+     * and do not start another walk from inside the callback. That is why the walks are
+     * non-const. A walk visits every node, so a callback cannot stop it early.
+     */
+    template <typename T>
+    class CompactTree
+    {
+    private:
+        std::vector<CompactNode<T>> _nodes;
+        CompactNode<T> *_root = nullptr;
+
+        template <typename F>
+        static void visit_reversed(CompactNode<T> *from, CompactNode<T> *to, F &f)
+        {
+            // visits the right-going path from..to bottom-up by reversing it in place and back
+            CompactNode<T> *prev = nullptr;
+            CompactNode<T> *node = from;
+            while (prev != to)
+            {
+                CompactNode<T> *next = node->_right;
+                node->_right = prev;
+                prev = node;
+                node = next;
+            }
+            node = to;
+            prev = nullptr;
+            while (prev != from)
+            {
+                f(node->_value);
+                CompactNode<T> *next = node->_right;
+                node->_right = prev;
+                prev = node;
+                node = next;
+            }
+        }
+
+        /*
+         * Morris skeleton: onDescend runs when a node's thread is set (first arrival with a
+         * left subtree), onLeaveLeft when the thread is removed (the left subtree is done),
+         * onNoLeft for nodes without a left subtree.
+         */
+        template <typename Descend, typename LeaveLeft, typename NoLeft>
+        void morris(Descend onDescend, LeaveLeft onLeaveLeft, NoLeft onNoLeft)
+        {
+            CompactNode<T> *node = this->_root;
+            while (node != nullptr)
+            {
+                if (node->_left == nullptr)
+                {
+                    onNoLeft(node);
+                    node = node->_right;
+                    continue;
+                }
+                CompactNode<T> *pred = node->_left;
+                while (pred->_right != nullptr && pred->_right != node)
+                {
+                    pred = pred->_right;
+                }
+                if (pred->_right == nullptr)
+                {
+                    onDescend(node);
+                    pred->_right = node;
+                    node = node->_left;
+                }
+                else
+                {
+                    pred->_right = nullptr;
+                    onLeaveLeft(node, pred);
+                    node = node->_right;
+                }
+            }
+        }
+
+    public:
+        CompactTree() = default;
+
+        template <typename Counters, typename KeyEqual, typename Hash, typename Aggregate>
+        explicit CompactTree(BinaryTree<T, Counters, KeyEqual, Hash, Aggregate> &tree)
+        {
+            std::size_t n = 0;
+            for (auto it = tree.begin_preorder(); it != tree.end_preorder(); ++it)
+            {
+                ++n;
+            }
+            if (n == 0)
+            {
+                return;
+            }
+            this->_nodes.reserve(n);
+
+            std::vector<std::pair<const Node<T, Aggregate> *, CompactNode<T> *>> pending;
+            const Node<T, Aggregate> *source = &tree.begin_preorder().Node();
+            this->_nodes.emplace_back(source->_value);
+            this->_root = &this->_nodes.back();
+            pending.emplace_back(source, this->_root);
+            while (!pending.empty())
+            {
+                auto [from, to] = pending.back();
+                pending.pop_back();
+                if (from->_right != nullptr)
+                {
+                    this->_nodes.emplace_back(from->_right->_value);
+                    to->_right = &this->_nodes.back();
+                    pending.emplace_back(from->_right, to->_right);
+                }
+                if (from->_left != nullptr)
+                {
+                    this->_nodes.emplace_back(from->_left->_value);
+                    to->_left = &this->_nodes.back();
+                    pending.emplace_back(from->_left, to->_left);
+                }
+            }
+        }
+
+        /*
+         * Loads a tree where node i holds values[i] and hangs below node parents[i], on the
+         * left when is_left[i] is true, with the same arrays and errors as
+         * BinaryTree::from_parent_array: a negative parent marks the root, values may repeat,
+         * and out-of-range parents, two children on one side, a missing or second root, or
+         * nodes unreachable from the root throw std::invalid_argument. O(n).
+         */
+        template <typename Values, typename Parents, typename Sides>
+        static CompactTree from_parent_array(const Values &values, const Parents &parents, const Sides &is_left)
+        {
+            CompactTree tree;
+            auto n = static_cast<std::size_t>(std::distance(std::begin(values), std::end(values)));
+            if (n != static_cast<std::size_t>(std::distance(std::begin(parents), std::end(parents))) ||
+                n != static_cast<std::size_t>(std::distance(std::begin(is_left), std::end(is_left))))
+            {
+                throw std::invalid_argument("arrays have different lengths");
+            }
+            if (n == 0)
+            {
+                return tree;
+            }
+            tree._nodes.reserve(n);
+            for (const auto &val : values)
+            {
+                tree._nodes.emplace_back(val);
+            }
+
+            auto parent = std::begin(parents);
+            auto side = std::begin(is_left);
+            for (std::size_t i = 0; i < n; ++i, ++parent, ++side)
+            {
+                CompactNode<T> *node = &tree._nodes[i];
+                if (*parent < 0)
+                {
+                    if (tree._root != nullptr)
+                    {
+                        throw std::invalid_argument("more than one root");
+                    }
+                    tree._root = node;
+                    continue;
+                }
+                auto p = static_cast<std::size_t>(*parent);
+                if (p >= n)
+                {
+                    throw std::invalid_argument("parent index out of range");
+                }
+                CompactNode<T> *&slot = *side ? tree._nodes[p]._left : tree._nodes[p]._right;
+                if (slot != nullptr)
+                {
+                    throw std::invalid_argument("two children on the same side");
+                }
+                slot = node;
+            }
+            // every node has one parent, so the nodes reached from the root form a tree;
+            // the rest hang in cycles of their own
+            std::size_t reached = 0;
+            if (tree._root != nullptr)
+            {
+                tree.for_each_preorder([&reached](const T & /*value*/) { ++reached; });
+            }
+            if (reached != n)
+            {
+                throw std::invalid_argument("nodes are not all reachable from one root");
+            }
+            return tree;
+        }
+
+        // nodes point into _nodes, so a copy would need relinking; move keeps the buffer
+        CompactTree(const CompactTree &) = delete;
+        CompactTree &operator=(const CompactTree &) = delete;
+        CompactTree(CompactTree &&tree) noexcept : _nodes(std::move(tree._nodes)), _root(tree._root)
+        {
+            tree._root = nullptr;
+        }
+        CompactTree &operator=(CompactTree &&tree) noexcept
+        {
+            this->_nodes = std::move(tree._nodes);
+            this->_root = tree._root;
+            tree._root = nullptr;
+            return *this;
+        }
+        ~CompactTree() = default;
+
+        std::size_t size() const
+        {
+            return this->_nodes.size();
+        }
+
+        template <typename F>
+        void for_each_preorder(F &&f)
+        {
+            morris([&](CompactNode<T> *node) { f(node->_value); },
+                   [](CompactNode<T> * /*node*/, CompactNode<T> * /*pred*/) {},
+                   [&](CompactNode<T> *node) { f(node->_value); });
+        }
+
+        template <typename F>
+        void for_each_inorder(F &&f)
+        {
+            morris([](CompactNode<T> * /*node*/) {},
+                   [&](CompactNode<T> *node, CompactNode<T> * /*pred*/) { f(node->_value); },
+                   [&](CompactNode<T> *node) { f(node->_value); });
+        }
+
+        template <typename F>
+        void for_each_postorder(F &&f)
+        {
+            if (this->_root == nullptr)
+            {
+                return;
+            }
+            morris([](CompactNode<T> * /*node*/) {},
+                   [&](CompactNode<T> *node, CompactNode<T> *pred) { visit_reversed(node->_left, pred, f); },
+                   [](CompactNode<T> * /*node*/) {});
+            CompactNode<T> *last = this->_root;
+            while (last->_right != nullptr)
+            {
+                last = last->_right;
+            }
+            visit_reversed(this->_root, last, f);
+        }
+    };
+}
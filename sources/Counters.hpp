@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace ariel
+{
+    /*
+     * Operation counters for BinaryTree, selected by its Counters template parameter.
+     * A counters policy provides the static hooks below; BinaryTree calls them at
+     * every find visit, iterator hop, node allocation and node free.
+     */
+    struct CounterSnapshot
+    {
+        std::uint64_t find_visits = 0;
+        std::uint64_t hops = 0;
+        std::uint64_t allocations = 0;
+        std::uint64_t frees = 0;
+        std::uint64_t max_depth = 0;
+    };
+
+    /*
+     * The default policy: every hook is an empty inline function, so nothing is emitted.
+     */
+    struct NoCounters
+    {
+        static void on_find_visit() {}
+        static void on_hop() {}
+        static void on_alloc() {}
+        static void on_free() {}
+        static void on_depth(std::size_t /*depth*/) {}
+    };
+
+    /*
+     * Process-wide counters shared by every tree instantiated with this policy.
+     * Updates are relaxed atomics, so they are safe from any thread and cost one
+     * uncontended atomic add. Use a distinct Tag to keep separate counter sets.
+     */
+    template <typename Tag = void>
+    struct AtomicCounters
+    {
+    private:
+        static inline std::atomic<std::uint64_t> _findVisits{0};
+        static inline std::atomic<std::uint64_t> _hops{0};
+        static inline std::atomic<std::uint64_t> _allocations{0};
+        static inline std::atomic<std::uint64_t> _frees{0};
+        static inline std::atomic<std::uint64_t> _maxDepth{0};
+
+    public:
+        static void on_find_visit()
+        {
+            _findVisits.fetch_add(1, std::memory_order_relaxed);
+        }
+        static void on_hop()
+        {
+            _hops.fetch_add(1, std::memory_order_relaxed);
+        }
+        static void on_alloc()
+        {
+            _allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+        static void on_free()
+        {
+            _frees.fetch_add(1, std::memory_order_relaxed);
+        }
+        static void on_depth(std::size_t depth)
+        {
+            std::uint64_t seen = _maxDepth.load(std::memory_order_relaxed);
+            while (depth > seen && !_maxDepth.compare_exchange_weak(seen, depth, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        static CounterSnapshot snapshot()
+        {
+            CounterSnapshot s;
+            s.find_visits = _findVisits.load(std::memory_order_relaxed);
+            s.hops = _hops.load(std::memory_order_relaxed);
+            s.allocations = _allocations.load(std::memory_order_relaxed);
+            s.frees = _frees.load(std::memory_order_relaxed);
+            s.max_depth = _maxDepth.load(std::memory_order_relaxed);
+            return s;
+        }
+
+        static void reset()
+        {
+            _findVisits.store(0, std::memory_order_relaxed);
+            _hops.store(0, std::memory_order_relaxed);
+            _allocations.store(0, std::memory_order_relaxed);
+            _frees.store(0, std::memory_order_relaxed);
+            _maxDepth.store(0, std::memory_order_relaxed);
+        }
+    };
+}
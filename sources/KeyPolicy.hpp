@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+
+namespace ariel
+{
+    /*
+     * KeyEqual and Hash policies that look at a projected key instead of the whole value.
+     * Projection is a default-constructible functor from the value type to its key, e.g.
+     *
+     *     struct RecordId { const int &operator()(const Record &r) const { return r.id; } };
+     *     BinaryTree<Record, NoCounters, key_equal<RecordId>, key_hash<RecordId>> tree;
+     *
+     * Arguments the projection does not accept are taken as keys already, so
+     * tree.find(42) compares 42 with r.id without building a Record.
+     */
+    template <typename Projection>
+    struct key_equal
+    {
+        template <typename A>
+        static decltype(auto) key(const A &a)
+        {
+            if constexpr (std::is_invocable_v<Projection, const A &>)
+            {
+                return Projection()(a);
+            }
+            else
+            {
+                return (a);
+            }
+        }
+
+        template <typename A, typename B>
+        bool operator()(const A &a, const B &b) const
+        {
+            return key(a) == key(b);
+        }
+    };
+
+    template <typename Projection>
+    struct key_hash
+    {
+        template <typename A>
+        std::size_t operator()(const A &a) const
+        {
+            const auto &k = key_equal<Projection>::key(a);
+            return std::hash<std::decay_t<decltype(k)>>()(k);
+        }
+    };
+}
@@ -0,0 +1,229 @@
+#pragma once
+#include "BinaryTree.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ariel
+{
+    /*
+     * Ancestor queries over a snapshot of a tree, for trees that are queried far more
+     * often than they change. Nodes are numbered in preorder, so a subtree is a
+     * contiguous range of numbers. Build is O(n log n) time and memory:
+     * lca answers in O(1) from a sparse table of the shallowest node in every
+     * power-of-two range of the preorder sequence; distance in O(1); level_ancestor
+     * in O(log n) by binary search among the nodes at the requested depth.
+     *
+     * Queries take node handles, or the preorder numbers returned by number(); the
+     * number overloads skip the handle lookup and are the ones to use in hot loops.
+     * The index does not follow edits: rebuild it after changing the tree's shape.
+     * Handles to nodes released since the build are rejected as stale.
+     */
+    template <typename Tree>
+    class LcaIndex
+    {
+    public:
+        using handle = typename Tree::node_handle;
+
+    private:
+        using NodeType = typename Tree::node_type;
+
+        std::vector<NodeType *> _nodes;                      // by preorder number
+        std::vector<std::uint32_t> _parent;                  // the root is its own parent
+        std::vector<std::uint32_t> _depth;                   // edges to the root
+        std::vector<std::vector<std::uint32_t>> _by_depth;   // numbers at each depth, ascending
+        std::vector<std::vector<std::uint32_t>> _shallowest; // [k][i]: shallowest in [i, i + 2^k)
+        std::vector<std::uint8_t> _log;                      // floor(log2(i))
+        std::unordered_map<const NodeType *, std::uint32_t> _number;
+
+        std::uint32_t shallower(std::uint32_t a, std::uint32_t b) const
+        {
+            return this->_depth[a] <= this->_depth[b] ? a : b;
+        }
+
+        // shallowest node among the numbers first..last, inclusive
+        std::uint32_t shallowest(std::uint32_t first, std::uint32_t last) const
+        {
+            std::uint8_t k = this->_log[last - first + 1];
+            return shallower(this->_shallowest[k][first], this->_shallowest[k][last + 1 - (1U << k)]);
+        }
+
+        void check(std::uint32_t n) const
+        {
+            if (n >= this->_nodes.size())
+            {
+                throw std::invalid_argument("node number out of range");
+            }
+        }
+
+    public:
+        explicit LcaIndex(Tree &tree)
+        {
+            for (auto it = tree.begin_preorder(); it != tree.end_preorder(); ++it)
+            {
+                NodeType *node = &it.Node();
+                auto n = static_cast<std::uint32_t>(this->_nodes.size());
+                std::uint32_t parent = node->_parent == nullptr ? n : this->_number.at(node->_parent);
+                std::uint32_t depth = node->_parent == nullptr ? 0 : this->_depth[parent] + 1;
+                this->_nodes.push_back(node);
+                this->_parent.push_back(parent);
+                this->_depth.push_back(depth);
+                this->_number.emplace(node, n);
+                if (depth == this->_by_depth.size())
+                {
+                    this->_by_depth.emplace_back();
+                }
+                this->_by_depth[depth].push_back(n);
+            }
+
+            std::size_t size = this->_nodes.size();
+            this->_log.assign(size + 1, 0);
+            for (std::size_t i = 2; i <= size; ++i)
+            {
+                this->_log[i] = static_cast<std::uint8_t>(this->_log[i / 2] + 1);
+            }
+            if (size == 0)
+            {
+                return;
+            }
+            this->_shallowest.emplace_back(size);
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                this->_shallowest[0][i] = static_cast<std::uint32_t>(i);
+            }
+            for (std::size_t k = 1; (std::size_t(1) << k) <= size; ++k)
+            {
+                std::size_t half = std::size_t(1) << (k - 1);
+                std::vector<std::uint32_t> level(size - 2 * half + 1);
+                for (std::size_t i = 0; i < level.size(); ++i)
+                {
+                    level[i] = shallower(this->_shallowest[k - 1][i], this->_shallowest[k - 1][i + half]);
+                }
+                this->_shallowest.push_back(std::move(level));
+            }
+        }
+
+        std::size_t size() const
+        {
+            return this->_nodes.size();
+        }
+
+        std::uint32_t number(handle h) const
+        {
+            auto found = this->_number.find(h._node);
+            if (found == this->_number.end())
+            {
+                throw std::invalid_argument("node is not in the index");
+            }
+            if (h._generation != h._node->_generation)
+            {
+                throw std::invalid_argument("stale node handle");
+            }
+            return found->second;
+        }
+
+        handle node(std::uint32_t n) const
+        {
+            check(n);
+            return handle(this->_nodes[n]);
+        }
+
+        std::size_t depth(std::uint32_t n) const
+        {
+            check(n);
+            return this->_depth[n];
+        }
+
+        std::size_t depth(handle h) const
+        {
+            return this->_depth[number(h)];
+        }
+
+        std::uint32_t lca(std::uint32_t a, std::uint32_t b) const
+        {
+            check(a);
+            check(b);
+            if (a == b)
+            {
+                return a;
+            }
+            if (a > b)
+            {
+                std::swap(a, b);
+            }
+            // the shallowest node after a up to b is the child of the answer on the way to b
+            return this->_parent[shallowest(a + 1, b)];
+        }
+
+        handle lca(handle a, handle b) const
+        {
+            return handle(this->_nodes[lca(number(a), number(b))]);
+        }
+
+        std::size_t distance(std::uint32_t a, std::uint32_t b) const
+        {
+            check(a);
+            check(b);
+            return this->_depth[a] + this->_depth[b] - 2 * std::size_t(this->_depth[lca(a, b)]);
+        }
+
+        std::size_t distance(handle a, handle b) const
+        {
+            return distance(number(a), number(b));
+        }
+
+        // the ancestor of n at the given depth (n itself at its own depth)
+        std::uint32_t level_ancestor(std::uint32_t n, std::size_t depth) const
+        {
+            check(n);
+            if (depth > this->_depth[n])
+            {
+                throw std::invalid_argument("depth is below the node");
+            }
+            // n's ancestor at that depth is the last node there that precedes n in preorder
+            const std::vector<std::uint32_t> &level = this->_by_depth[depth];
+            return *(std::upper_bound(level.begin(), level.end(), n) - 1);
+        }
+
+        handle level_ancestor(handle h, std::size_t depth) const
+        {
+            return handle(this->_nodes[level_ancestor(number(h), depth)]);
+        }
+
+        /*
+         * Batch lca: resolves every handle first and then answers from the table in a
+         * second pass, so the hash lookups and the table reads do not evict each other.
+         */
+        std::vector<handle> lca(const std::vector<std::pair<handle, handle>> &queries) const
+        {
+            std::vector<std::pair<std::uint32_t, std::uint32_t>> numbers;
+            numbers.reserve(queries.size());
+            for (const auto &query : queries)
+            {
+                numbers.emplace_back(number(query.first), number(query.second));
+            }
+            std::vector<handle> answers;
+            answers.reserve(queries.size());
+            for (const auto &query : numbers)
+            {
+                answers.push_back(handle(this->_nodes[lca(query.first, query.second)]));
+            }
+            return answers;
+        }
+
+        std::vector<std::uint32_t> lca(const std::vector<std::pair<std::uint32_t, std::uint32_t>> &queries) const
+        {
+            std::vector<std::uint32_t> answers;
+            answers.reserve(queries.size());
+            for (const auto &query : queries)
+            {
+                answers.push_back(lca(query.first, query.second));
+            }
+            return answers;
+        }
+    };
+}
@@ -1,23 +1,28 @@
 #pragma once
+#include "Aggregate.hpp"
+#include <cstdint>
+
 namespace ariel
 {
-    template <typename T>
-    class Node
+    template <typename T, typename Aggregate = NoAggregate>
+    class Node : public AggregateSlot<Aggregate>
     {
     public:
         T _value;
-        Node<T> *_left;
-        Node<T> *_right;
-        Node<T> *_parent;
+        Node *_left;
+        Node *_right;
+        Node *_parent;
+        std::uint32_t _generation = 0; // bumped whenever the tree releases this node
+        bool _arena = false;           // allocated in a bulk arena, never deleted on its own
 
         void add_right(T val)
         {
-            this->_right = new Node<T>(val);
+            this->_right = new Node(val);
             this->_right->_parent = this;
         }
         void add_left(T val)
         {
-            this->_left = new Node<T>(val);
+            this->_left = new Node(val);
             this->_left->_parent = this;
         }
         Node() : _left(nullptr), _right(nullptr), _parent(nullptr) {}
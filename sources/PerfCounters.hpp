@@ -0,0 +1,162 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ariel
+{
+    /*
+     * Hardware counters around a measured region, read through Linux perf_event_open.
+     * Each event is opened on its own, so a missing event (common in containers and VMs,
+     * or with perf_event_paranoid > 2) only disables that column.
+     * Counts are scaled when the kernel multiplexed the counters.
+     */
+    class PerfCounters
+    {
+    public:
+        enum Event
+        {
+            CYCLES,
+            INSTRUCTIONS,
+            L1D_MISSES,
+            LLC_MISSES,
+            BRANCH_MISSES,
+            EVENT_COUNT
+        };
+
+        static const char *name(Event event)
+        {
+            static const std::array<const char *, EVENT_COUNT> names{"cycles", "instructions", "L1d-misses", "LLC-misses", "branch-misses"};
+            return names.at(event);
+        }
+
+    private:
+        std::array<int, EVENT_COUNT> _fds{};
+        std::array<double, EVENT_COUNT> _values{};
+
+#ifdef __linux__
+        struct Reading
+        {
+            std::uint64_t value;
+            std::uint64_t enabled;
+            std::uint64_t running;
+        };
+
+        static int open(std::uint32_t type, std::uint64_t config)
+        {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+
+        static constexpr std::uint64_t cacheReadMiss(std::uint64_t cache)
+        {
+            return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8U) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16U);
+        }
+#endif
+
+    public:
+        PerfCounters()
+        {
+            this->_fds.fill(-1);
+#ifdef __linux__
+            this->_fds[CYCLES] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+            this->_fds[INSTRUCTIONS] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+            this->_fds[L1D_MISSES] = open(PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_L1D));
+            this->_fds[LLC_MISSES] = open(PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_LL));
+            this->_fds[BRANCH_MISSES] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+        }
+        PerfCounters(const PerfCounters &) = delete;
+        PerfCounters &operator=(const PerfCounters &) = delete;
+        PerfCounters(PerfCounters &&) = delete;
+        PerfCounters &operator=(PerfCounters &&) = delete;
+        ~PerfCounters()
+        {
+#ifdef __linux__
+            for (int fd : this->_fds)
+            {
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+            }
+#endif
+        }
+
+        bool available(Event event) const
+        {
+            return this->_fds.at(event) >= 0;
+        }
+
+        bool any_available() const
+        {
+            for (int fd : this->_fds)
+            {
+                if (fd >= 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void start()
+        {
+#ifdef __linux__
+            for (int fd : this->_fds)
+            {
+                if (fd >= 0)
+                {
+                    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+                }
+            }
+#endif
+        }
+
+        void stop()
+        {
+            this->_values.fill(0);
+#ifdef __linux__
+            for (int fd : this->_fds)
+            {
+                if (fd >= 0)
+                {
+                    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                }
+            }
+            for (std::size_t i = 0; i < EVENT_COUNT; ++i)
+            {
+                Reading r{};
+                if (this->_fds.at(i) < 0 || ::read(this->_fds.at(i), &r, sizeof(r)) != sizeof(r) || r.running == 0)
+                {
+                    continue;
+                }
+                this->_values.at(i) = static_cast<double>(r.value) * static_cast<double>(r.enabled) / static_cast<double>(r.running);
+            }
+#endif
+        }
+
+        /*
+         * Count of the last start()/stop() region; 0 when the event is unavailable.
+         */
+        double value(Event event) const
+        {
+            return this->_values.at(event);
+        }
+    };
+}
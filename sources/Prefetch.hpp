@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+
+/*
+ * How far ahead traversal loops prefetch. Only the walk<W> stack iterators use the
+ * distance itself: they prefetch the pending entry this many positions behind the
+ * next one. Everything else only knows the node it stands on, so for the
+ * parent-pointer iterators, the searches and for_each_* the value is a switch:
+ * any n > 0 prefetches both children of every node entered (one hop ahead), and 0
+ * turns every hint off. Override with -DARIEL_PREFETCH_DISTANCE=n
+ * (make bench PREFETCH=n); distances above 1 change only the stack-* rows there.
+ */
+#ifndef ARIEL_PREFETCH_DISTANCE
+#define ARIEL_PREFETCH_DISTANCE 1
+#endif
+
+namespace ariel
+{
+    constexpr std::size_t PREFETCH_DISTANCE = ARIEL_PREFETCH_DISTANCE;
+
+    // a hint only: null and dangling addresses do not fault
+    inline void prefetch(const void *address)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        if constexpr (PREFETCH_DISTANCE > 0)
+        {
+            __builtin_prefetch(address, 0, 3);
+        }
+#else
+        (void)address;
+#endif
+    }
+
+    template <typename N>
+    inline void prefetch_children(const N *node)
+    {
+        if constexpr (PREFETCH_DISTANCE > 0)
+        {
+            prefetch(node->_left);
+            prefetch(node->_right);
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "BinaryTree.hpp"
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace ariel
+{
+    /*
+     * A frozen snapshot of a tree's values in inorder that answers range aggregates in
+     * O(1), for any Aggregate policy (see Aggregate.hpp); the tree itself needs none.
+     *
+     * It is a disjoint sparse table: level k cuts the positions into blocks of 2^(k+1)
+     * and stores, for each position, the aggregate from it to the middle of its block.
+     * Positions first < last lie on opposite sides of the middle at exactly one level,
+     * the highest bit where they differ, so every query is one combine of two entries.
+     * Unlike the overlapping sparse table this needs no idempotence, so sums work too.
+     * Build is O(n log n) time and memory. Rebuild it after editing the tree.
+     */
+    template <typename Aggregate>
+    class RangeTable
+    {
+    public:
+        using value_type = typename Aggregate::value_type;
+
+    private:
+        std::vector<value_type> _values;              // lifted, by inorder position
+        std::vector<std::vector<value_type>> _levels; // [k][i]: i to the middle of its 2^(k+1) block
+
+        static std::size_t highest_bit(std::size_t x)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return sizeof(unsigned long long) * 8 - 1 - static_cast<std::size_t>(__builtin_clzll(x));
+#else
+            std::size_t bit = 0;
+            while ((x >>= 1U) != 0)
+            {
+                ++bit;
+            }
+            return bit;
+#endif
+        }
+
+    public:
+        template <typename Tree>
+        explicit RangeTable(Tree &tree)
+        {
+            for (auto it = tree.begin_inorder(); it != tree.end_inorder(); ++it)
+            {
+                this->_values.push_back(Aggregate::lift(*it));
+            }
+            std::size_t n = this->_values.size();
+            for (std::size_t half = 1; half < n; half *= 2)
+            {
+                std::vector<value_type> level(n);
+                for (std::size_t middle = half; middle < n; middle += 2 * half)
+                {
+                    level[middle - 1] = this->_values[middle - 1];
+                    for (std::size_t i = middle - 1; i > middle - half; --i)
+                    {
+                        level[i - 1] = Aggregate::combine(this->_values[i - 1], level[i]);
+                    }
+                    level[middle] = this->_values[middle];
+                    for (std::size_t i = middle + 1; i < middle + half && i < n; ++i)
+                    {
+                        level[i] = Aggregate::combine(level[i - 1], this->_values[i]);
+                    }
+                }
+                this->_levels.push_back(std::move(level));
+            }
+        }
+
+        std::size_t size() const
+        {
+            return this->_values.size();
+        }
+
+        // the aggregate of inorder positions first..last, inclusive
+        value_type query(std::size_t first, std::size_t last) const
+        {
+            if (first > last || last >= this->_values.size())
+            {
+                throw std::invalid_argument("position out of range");
+            }
+            if (first == last)
+            {
+                return this->_values[first];
+            }
+            const std::vector<value_type> &level = this->_levels[highest_bit(first ^ last)];
+            return Aggregate::combine(level[first], level[last]);
+        }
+    };
+}
@@ -0,0 +1,303 @@
+#pragma once
+#include "Node.hpp"
+#include "Prefetch.hpp"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace ariel
+{
+    enum class Walk
+    {
+        PREORDER,
+        INORDER,
+        POSTORDER,
+        LEVEL_ORDER
+    };
+
+    /*
+     * A sequence of pointers kept inline up to N entries; past that every entry moves to
+     * the heap until the buffer empties again. Supports stack (back) and queue (front) use.
+     */
+    template <typename P, std::size_t N>
+    class SmallBuffer
+    {
+    private:
+        std::array<P, N> _inline{};
+        std::vector<P> _heap;
+        std::size_t _head = 0;
+        std::size_t _size = 0;
+
+        P *data()
+        {
+            return this->_heap.empty() ? this->_inline.data() : this->_heap.data();
+        }
+
+        void reset()
+        {
+            this->_head = 0;
+            this->_size = 0;
+            this->_heap.clear();
+        }
+
+    public:
+        bool empty() const
+        {
+            return this->_head == this->_size;
+        }
+
+        void push_back(P p)
+        {
+            if (this->_heap.empty())
+            {
+                if (this->_size < N)
+                {
+                    this->_inline[this->_size++] = p;
+                    return;
+                }
+                this->_heap.assign(this->_inline.begin(), this->_inline.end());
+            }
+            this->_heap.push_back(p);
+            ++this->_size;
+        }
+
+        P back()
+        {
+            return this->data()[this->_size - 1];
+        }
+
+        void pop_back()
+        {
+            --this->_size;
+            if (!this->_heap.empty())
+            {
+                this->_heap.pop_back();
+            }
+            if (this->empty())
+            {
+                this->reset();
+            }
+        }
+
+        // the entry k places below the top (or behind the head, for a queue), or a null P
+        P below_back(std::size_t k)
+        {
+            return this->_size - this->_head > k ? this->data()[this->_size - 1 - k] : P();
+        }
+
+        P behind_front(std::size_t k)
+        {
+            return this->_size - this->_head > k ? this->data()[this->_head + k] : P();
+        }
+
+        P front()
+        {
+            return this->data()[this->_head];
+        }
+
+        void pop_front()
+        {
+            ++this->_head;
+            if (this->empty())
+            {
+                this->reset();
+            }
+            else if (!this->_heap.empty() && this->_head * 2 >= this->_size)
+            {
+                // drop the consumed half so a long queue does not keep every entry it ever held
+                this->_heap.erase(this->_heap.begin(), this->_heap.begin() + static_cast<std::ptrdiff_t>(this->_head));
+                this->_size -= this->_head;
+                this->_head = 0;
+            }
+        }
+    };
+
+    /*
+     * Walks a tree keeping the pending nodes on an explicit stack (a queue for level
+     * order) instead of climbing _parent pointers. Each step is one push or pop plus
+     * at most a descent, with no comparison against the previous node. The first 64
+     * entries stay inside the iterator, so trees up to that depth walk without allocating.
+     * Copying the iterator copies the buffer.
+     */
+    template <typename T, Walk W, typename Aggregate = NoAggregate, std::size_t N = 64>
+    class stack_iterator
+    {
+    private:
+        Node<T, Aggregate> *_current = nullptr;
+        SmallBuffer<Node<T, Aggregate> *, N> _pending;
+
+        // pushes node and its leftmost path; inorder visits the last one pushed first
+        void push_left_path(Node<T, Aggregate> *node)
+        {
+            while (node != nullptr)
+            {
+                this->_pending.push_back(node);
+                node = node->_left;
+            }
+        }
+
+        // pushes the path from node to its first node in postorder
+        void push_first_leaf_path(Node<T, Aggregate> *node)
+        {
+            while (node != nullptr)
+            {
+                this->_pending.push_back(node);
+                node = node->_left != nullptr ? node->_left : node->_right;
+            }
+        }
+
+        void settle()
+        {
+            this->_current = this->_pending.empty() ? nullptr : (W == Walk::LEVEL_ORDER ? this->_pending.front() : this->_pending.back());
+            this->prefetch_ahead();
+        }
+
+        void prefetch_ahead()
+        {
+            if constexpr (PREFETCH_DISTANCE > 0)
+            {
+                if (this->_current != nullptr)
+                {
+                    prefetch_children(this->_current);
+                }
+                prefetch(W == Walk::LEVEL_ORDER ? this->_pending.behind_front(PREFETCH_DISTANCE) : this->_pending.below_back(PREFETCH_DISTANCE));
+            }
+        }
+
+    public:
+        stack_iterator() = default;
+
+        explicit stack_iterator(Node<T, Aggregate> *root)
+        {
+            if (root == nullptr)
+            {
+                return;
+            }
+            switch (W)
+            {
+            case Walk::PREORDER:
+                this->_current = root;
+                this->prefetch_ahead();
+                return;
+            case Walk::INORDER:
+                this->push_left_path(root);
+                break;
+            case Walk::POSTORDER:
+                this->push_first_leaf_path(root);
+                break;
+            case Walk::LEVEL_ORDER:
+                this->_pending.push_back(root);
+                break;
+            }
+            this->settle();
+        }
+
+        T &operator*() const
+        {
+            return this->_current->_value;
+        }
+
+        T *operator->() const
+        {
+            return &(this->_current->_value);
+        }
+
+        bool operator==(const stack_iterator &rhs) const
+        {
+            return this->_current == rhs._current;
+        }
+
+        bool operator!=(const stack_iterator &rhs) const
+        {
+            return this->_current != rhs._current;
+        }
+
+        stack_iterator &operator++()
+        {
+            Node<T, Aggregate> *node = this->_current;
+            switch (W)
+            {
+            case Walk::PREORDER:
+                // the stack holds right children still to visit
+                if (node->_left != nullptr)
+                {
+                    if (node->_right != nullptr)
+                    {
+                        this->_pending.push_back(node->_right);
+                    }
+                    this->_current = node->_left;
+                }
+                else if (node->_right != nullptr)
+                {
+                    this->_current = node->_right;
+                }
+                else if (this->_pending.empty())
+                {
+                    this->_current = nullptr;
+                }
+                else
+                {
+                    this->_current = this->_pending.back();
+                    this->_pending.pop_back();
+                }
+                this->prefetch_ahead();
+                return *this;
+            case Walk::INORDER:
+                this->_pending.pop_back();
+                this->push_left_path(node->_right);
+                break;
+            case Walk::POSTORDER:
+                this->_pending.pop_back();
+                if (!this->_pending.empty())
+                {
+                    Node<T, Aggregate> *parent = this->_pending.back();
+                    if (parent->_left == node)
+                    {
+                        this->push_first_leaf_path(parent->_right);
+                    }
+                }
+                break;
+            case Walk::LEVEL_ORDER:
+                this->_pending.pop_front();
+                if (node->_left != nullptr)
+                {
+                    this->_pending.push_back(node->_left);
+                }
+                if (node->_right != nullptr)
+                {
+                    this->_pending.push_back(node->_right);
+                }
+                break;
+            }
+            this->settle();
+            return *this;
+        }
+
+        stack_iterator operator++(int)
+        {
+            stack_iterator temp = *this;
+            this->operator++();
+            return temp;
+        }
+    };
+
+    template <typename T, Walk W, typename Aggregate = NoAggregate>
+    class stack_range
+    {
+    private:
+        Node<T, Aggregate> *_root;
+
+    public:
+        explicit stack_range(Node<T, Aggregate> *root) : _root(root) {}
+
+        stack_iterator<T, W, Aggregate> begin() const
+        {
+            return stack_iterator<T, W, Aggregate>(this->_root);
+        }
+
+        stack_iterator<T, W, Aggregate> end() const
+        {
+            return stack_iterator<T, W, Aggregate>();
+        }
+    };
+}
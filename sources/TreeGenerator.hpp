@@ -0,0 +1,306 @@
+#pragma once
+#include "BinaryTree.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace ariel
+{
+    enum class Shape
+    {
+        COMPLETE,     // every level full except the last, which is filled from the left
+        PERFECT,      // every level full; n is rounded down to 2^k - 1
+        LEFT_CHAIN,   // every node has only a left child
+        RIGHT_CHAIN,  // every node has only a right child
+        RANDOM_SPLIT, // the left subtree size is uniform in [0, n - 1] at every node
+        FIBONACCI,    // order k has order k-1 on the left and order k-2 on the right
+        CATERPILLAR   // a right spine where every spine node has a left leaf
+    };
+
+    enum class Values
+    {
+        SEQUENTIAL, // 0, 1, 2, ... in preorder
+        SHUFFLED,   // a random permutation of 0..n-1
+        UNIFORM,    // uniform in [0, range)
+        DUPLICATES, // uniform over a small pool of distinct values
+        CONSTANT    // every node holds 0
+    };
+
+    /*
+     * Converts a generated key to a tree value.
+     * Specialize for value types that are not constructible from an integer.
+     */
+    template <typename T>
+    struct value_of
+    {
+        T operator()(std::uint64_t key) const
+        {
+            return static_cast<T>(key);
+        }
+    };
+
+    template <>
+    struct value_of<std::string>
+    {
+        std::string operator()(std::uint64_t key) const
+        {
+            return std::to_string(key);
+        }
+    };
+
+    /*
+     * Builds reproducible trees of a given shape by linking nodes directly,
+     * without calling find for every insert.
+     * Two generators constructed with the same seed produce the same trees.
+     * Values are assigned in preorder.
+     * Tree may be any BinaryTree over T: nodes come from its own allocator, so its
+     * Counters see every allocation, and its aggregates are computed once at the end.
+     */
+    template <typename T, typename Tree = BinaryTree<T>>
+    class TreeGenerator
+    {
+    private:
+        static_assert(std::is_same_v<typename Tree::value_type, T>, "Tree must hold values of type T");
+        using NodeType = typename Tree::node_type;
+
+        std::mt19937_64 _rng;
+        Values _values = Values::SEQUENTIAL;
+        std::uint64_t _range = 0;
+        std::vector<std::size_t> _fibonacciSizes{0, 1};
+
+        struct Pending
+        {
+            NodeType *parent;
+            bool isLeft;
+            std::size_t size;
+        };
+
+        std::vector<std::uint64_t> keys(std::size_t n)
+        {
+            std::vector<std::uint64_t> out(n);
+            switch (this->_values)
+            {
+            case Values::SEQUENTIAL:
+            case Values::SHUFFLED:
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    out[i] = i;
+                }
+                if (this->_values == Values::SHUFFLED)
+                {
+                    std::shuffle(out.begin(), out.end(), this->_rng);
+                }
+                break;
+            case Values::UNIFORM:
+            case Values::DUPLICATES:
+            {
+                std::uint64_t range = this->_range;
+                if (range == 0)
+                {
+                    range = this->_values == Values::UNIFORM ? UINT32_MAX : n / 8 + 1;
+                }
+                std::uniform_int_distribution<std::uint64_t> dist(0, range - 1);
+                for (auto &key : out)
+                {
+                    key = dist(this->_rng);
+                }
+                break;
+            }
+            case Values::CONSTANT:
+                break;
+            }
+            return out;
+        }
+
+        static std::size_t completeLeftSize(std::size_t size)
+        {
+            if (size <= 1)
+            {
+                return 0;
+            }
+            std::size_t full = 1; // 2^h where h is the height of the tree
+            while (full * 2 <= size)
+            {
+                full *= 2;
+            }
+            std::size_t lastLevel = size - (full - 1);
+            return (full / 2 - 1) + std::min(lastLevel, full / 2);
+        }
+
+        std::size_t fibonacciLeftSize(std::size_t size)
+        {
+            while (this->_fibonacciSizes.back() < size)
+            {
+                std::size_t k = this->_fibonacciSizes.size();
+                this->_fibonacciSizes.push_back(this->_fibonacciSizes[k - 1] + this->_fibonacciSizes[k - 2] + 1);
+            }
+            auto it = std::lower_bound(this->_fibonacciSizes.begin(), this->_fibonacciSizes.end(), size);
+            if (*it != size)
+            {
+                throw std::invalid_argument("size is not the size of a Fibonacci tree");
+            }
+            return it == this->_fibonacciSizes.begin() ? 0 : *(it - 1);
+        }
+
+        std::size_t leftSize(Shape shape, std::size_t size)
+        {
+            switch (shape)
+            {
+            case Shape::COMPLETE:
+                return completeLeftSize(size);
+            case Shape::PERFECT:
+                return (size - 1) / 2;
+            case Shape::LEFT_CHAIN:
+                return size - 1;
+            case Shape::RIGHT_CHAIN:
+                return 0;
+            case Shape::RANDOM_SPLIT:
+                return std::uniform_int_distribution<std::size_t>(0, size - 1)(this->_rng);
+            case Shape::FIBONACCI:
+                return fibonacciLeftSize(size);
+            case Shape::CATERPILLAR:
+                return size >= 2 ? 1 : 0;
+            }
+            return 0;
+        }
+
+    public:
+        explicit TreeGenerator(std::uint64_t seed = 0) : _rng(seed) {}
+
+        /*
+         * Selects the value distribution for the following builds.
+         * range bounds UNIFORM and DUPLICATES keys; 0 picks a default
+         * (2^32 for UNIFORM, n/8 + 1 distinct values for DUPLICATES).
+         */
+        TreeGenerator &values(Values values, std::uint64_t range = 0)
+        {
+            this->_values = values;
+            this->_range = range;
+            return *this;
+        }
+
+        /*
+         * Number of nodes in the Fibonacci tree of the given order.
+         */
+        std::size_t fibonacci_size(std::size_t order)
+        {
+            while (this->_fibonacciSizes.size() <= order)
+            {
+                std::size_t k = this->_fibonacciSizes.size();
+                this->_fibonacciSizes.push_back(this->_fibonacciSizes[k - 1] + this->_fibonacciSizes[k - 2] + 1);
+            }
+            return this->_fibonacciSizes[order];
+        }
+
+        /*
+         * Builds a tree of n nodes (rounded down to a valid size for PERFECT and FIBONACCI).
+         * Construction is iterative, so degenerate chains of any length are fine.
+         */
+        Tree build(Shape shape, std::size_t n)
+        {
+            if (shape == Shape::PERFECT)
+            {
+                std::size_t full = 1;
+                while (full * 2 - 1 <= n)
+                {
+                    full *= 2;
+                }
+                n = full - 1;
+            }
+            else if (shape == Shape::FIBONACCI)
+            {
+                std::size_t order = 0;
+                while (fibonacci_size(order + 1) <= n)
+                {
+                    ++order;
+                }
+                n = fibonacci_size(order);
+            }
+
+            Tree tree;
+            if (n == 0)
+            {
+                return tree;
+            }
+            std::vector<std::uint64_t> values = keys(n);
+            value_of<T> convert;
+            std::size_t next = 0;
+
+            std::vector<Pending> stack;
+            stack.push_back({nullptr, false, n});
+            while (!stack.empty())
+            {
+                Pending p = stack.back();
+                stack.pop_back();
+
+                NodeType *node = tree.new_node(convert(values[next++]));
+                if (p.parent == nullptr)
+                {
+                    tree._root = node;
+                }
+                else if (p.isLeft)
+                {
+                    p.parent->_left = node;
+                    node->_parent = p.parent;
+                }
+                else
+                {
+                    p.parent->_right = node;
+                    node->_parent = p.parent;
+                }
+
+                std::size_t left = leftSize(shape, p.size);
+                std::size_t right = p.size - 1 - left;
+                if (right > 0)
+                {
+                    stack.push_back({node, false, right});
+                }
+                if (left > 0)
+                {
+                    stack.push_back({node, true, left});
+                }
+            }
+            tree.refresh_all();
+            return tree;
+        }
+
+        Tree complete(std::size_t n)
+        {
+            return build(Shape::COMPLETE, n);
+        }
+
+        Tree perfect(std::size_t height)
+        {
+            return build(Shape::PERFECT, (std::size_t{2} << height) - 1);
+        }
+
+        Tree left_chain(std::size_t n)
+        {
+            return build(Shape::LEFT_CHAIN, n);
+        }
+
+        Tree right_chain(std::size_t n)
+        {
+            return build(Shape::RIGHT_CHAIN, n);
+        }
+
+        Tree random_split(std::size_t n)
+        {
+            return build(Shape::RANDOM_SPLIT, n);
+        }
+
+        Tree fibonacci(std::size_t order)
+        {
+            return build(Shape::FIBONACCI, fibonacci_size(order));
+        }
+
+        Tree caterpillar(std::size_t n)
+        {
+            return build(Shape::CATERPILLAR, n);
+        }
+    };
+}